@@ -0,0 +1,153 @@
+#ifndef CLICK_IGMPADDRESSMAP_HH
+#define CLICK_IGMPADDRESSMAP_HH
+
+#include <click/ipaddress.hh>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+#include "IGMPSlotTable.hh"
+
+CLICK_DECLS
+
+// Map from IPv4 addresses to T on a SlotTable, like AddressSet.
+// A slot only holds the address and the index of its value, so a lookup walks one flat array.
+// The values live in a pool of fixed chunks and never move: they can hold intrusive timers and
+// be pointed to for as long as they are in the map. An erased value is destroyed and its place is
+// reused by a later insert. Nothing is allocated before the first insert, 0.0.0.0 can't be stored.
+template <typename T>
+class AddressMap {
+	struct Slot {
+		uint32_t key;
+		uint32_t index;
+	};
+
+	static constexpr uint32_t CHUNK = 16;
+
+	using Chunk = std::unique_ptr<T[]>;
+
+public:
+	// iterates the values, the map must not change while iterating
+	template <typename V>
+	class basic_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = T;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = V*;
+		using reference         = V&;
+
+		basic_iterator(const Slot* slot, const Slot* end, const Chunk* chunks)
+		    : slot(slot), end(end), chunks(chunks) {
+			skip();
+		}
+
+		V& operator*() const { return chunks[slot->index / CHUNK][slot->index % CHUNK]; }
+		V* operator->() const { return &**this; }
+
+		basic_iterator& operator++() {
+			++slot;
+			skip();
+			return *this;
+		}
+
+		basic_iterator operator++(int) {
+			auto old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const basic_iterator& other) const { return slot == other.slot; }
+		bool operator!=(const basic_iterator& other) const { return slot != other.slot; }
+
+	private:
+		const Slot*  slot;
+		const Slot*  end;
+		const Chunk* chunks;
+
+		void skip() {
+			while (slot != end && !slot->key) ++slot;
+		}
+	};
+
+	using iterator       = basic_iterator<T>;
+	using const_iterator = basic_iterator<const T>;
+
+	T* find(IPAddress address) {
+		auto i = table.find(address.addr());
+		return i == Table::NONE ? nullptr : &value(table[i].index);
+	}
+
+	const T* find(IPAddress address) const {
+		auto i = table.find(address.addr());
+		return i == Table::NONE ? nullptr : &value(table[i].index);
+	}
+
+	// The value for the address, default constructed when it is new. created is set to whether
+	// it was. The address must not be 0.0.0.0.
+	T& insert(IPAddress address, bool* created = nullptr) {
+		bool  isNew = false;
+		auto& slot  = table.insert(address.addr(), isNew);
+		if (isNew) slot.index = allocate();
+		if (created) *created = isNew;
+		return value(slot.index);
+	}
+
+	// true if the address was in the map, its value is destroyed
+	bool erase(IPAddress address) {
+		auto i = table.find(address.addr());
+		if (i == Table::NONE) return false;
+		release(table[i].index);
+		table.erase(i);
+		return true;
+	}
+
+	size_t size() const { return table.size(); }
+
+	bool empty() const { return !table.size(); }
+
+	// values the chunks have room for, the map never gives memory back before it's destroyed
+	size_t capacity() const { return chunks.size() * CHUNK; }
+
+	iterator begin() { return iterator(table.begin(), table.end(), chunks.data()); }
+
+	iterator end() { return iterator(table.end(), table.end(), chunks.data()); }
+
+	const_iterator begin() const {
+		return const_iterator(table.begin(), table.end(), chunks.data());
+	}
+
+	const_iterator end() const { return const_iterator(table.end(), table.end(), chunks.data()); }
+
+private:
+	using Table = SlotTable<Slot>;
+
+	Table                 table;
+	std::vector<Chunk>    chunks;
+	std::vector<uint32_t> released;    // indices of erased values, reused first
+	uint32_t              used = 0;    // values handed out of the chunks so far
+
+	T& value(uint32_t index) const { return chunks[index / CHUNK][index % CHUNK]; }
+
+	uint32_t allocate() {
+		if (!released.empty()) {
+			auto index = released.back();
+			released.pop_back();
+			return index;
+		}
+		if (used % CHUNK == 0) chunks.emplace_back(new T[CHUNK]);
+		return used++;
+	}
+
+	void release(uint32_t index) {
+		// start the next user of this place from a default value
+		auto& v = value(index);
+		v.~T();
+		new (&v) T();
+		released.push_back(index);
+	}
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPADDRESSMAP_HH
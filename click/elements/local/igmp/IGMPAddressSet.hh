@@ -0,0 +1,87 @@
+#ifndef CLICK_IGMPADDRESSSET_HH
+#define CLICK_IGMPADDRESSSET_HH
+
+#include <click/ipaddress.hh>
+#include <iterator>
+#include "IGMPSlotTable.hh"
+
+CLICK_DECLS
+
+// Set of IPv4 addresses on a SlotTable. The addresses are stored in one flat array, so a lookup
+// usually touches a single cache line. 0.0.0.0 can't be stored.
+class AddressSet {
+	struct Slot {
+		uint32_t key;
+	};
+
+public:
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = IPAddress;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const IPAddress*;
+		using reference         = IPAddress;
+
+		const_iterator(const Slot* slot, const Slot* end) : slot(slot), end(end) { skip(); }
+
+		IPAddress operator*() const { return IPAddress(slot->key); }
+
+		const_iterator& operator++() {
+			++slot;
+			skip();
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			auto old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const const_iterator& other) const { return slot == other.slot; }
+		bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+
+	private:
+		const Slot* slot;
+		const Slot* end;
+
+		void skip() {
+			while (slot != end && !slot->key) ++slot;
+		}
+	};
+
+	bool contains(IPAddress address) const {
+		return table.find(address.addr()) != SlotTable<Slot>::NONE;
+	}
+
+	// true if the address wasn't in the set yet
+	bool insert(IPAddress address) {
+		bool created = false;
+		if (address.addr()) table.insert(address.addr(), created);
+		return created;
+	}
+
+	// true if the address was in the set
+	bool erase(IPAddress address) {
+		auto i = table.find(address.addr());
+		if (i == SlotTable<Slot>::NONE) return false;
+		table.erase(i);
+		return true;
+	}
+
+	size_t size() const { return table.size(); }
+
+	bool empty() const { return !table.size(); }
+
+	const_iterator begin() const { return const_iterator(table.begin(), table.end()); }
+
+	const_iterator end() const { return const_iterator(table.end(), table.end()); }
+
+private:
+	SlotTable<Slot> table;
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPADDRESSSET_HH
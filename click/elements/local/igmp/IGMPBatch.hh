@@ -0,0 +1,23 @@
+#ifndef CLICK_IGMPBATCH_HH
+#define CLICK_IGMPBATCH_HH
+
+#include <click/element.hh>
+
+// FastClick hands packets over in batches, plain Click one at a time. Elements that can classify
+// a whole burst at once derive from IGMPBatchElement and also implement push_batch when the tree
+// is built with batching, the plain push path keeps working either way.
+#if HAVE_BATCH
+#	include <click/batchelement.hh>
+#endif
+
+CLICK_DECLS
+
+#if HAVE_BATCH
+using IGMPBatchElement = BatchElement;
+#else
+using IGMPBatchElement = Element;
+#endif
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPBATCH_HH
@@ -0,0 +1,108 @@
+#include <click/config.h>
+#include "IGMPChecksum.hh"
+#include <cstring>
+
+// SIMD only at userlevel, the kernel doesn't save the vector registers for us
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#	define IGMP_CHECKSUM_X86 1
+#	include <immintrin.h>
+#endif
+
+CLICK_DECLS
+
+namespace {
+
+// The functions below return the one's complement sum of the 16 bit words in a buffer, not yet
+// folded. They may leave the last length % 16 or % 32 bytes to the scalar loop.
+using SumFunction = uint64_t (*)(const unsigned char* data, size_t length);
+
+// four words at a time in a 64 bit accumulator, the carries are folded in at the end
+uint64_t sumScalar(const unsigned char* data, size_t length) {
+	uint64_t sum = 0;
+	for (; length >= 4; data += 4, length -= 4) {
+		uint32_t word;
+		memcpy(&word, data, 4);
+		sum += word;
+	}
+	if (length >= 2) {
+		uint16_t word;
+		memcpy(&word, data, 2);
+		sum += word;
+		data += 2;
+		length -= 2;
+	}
+	if (length) {
+		// an odd byte is the first half of a word padded with zero
+		uint16_t word = 0;
+		memcpy(&word, data, 1);
+		sum += word;
+	}
+	return sum;
+}
+
+#if IGMP_CHECKSUM_X86
+// Widen the 16 bit words to 32 bit lanes and add those. A lane can take 65536 words before it
+// overflows, far more than the largest ip packet holds.
+__attribute__((target("sse2"))) uint64_t sumSSE2(const unsigned char* data, size_t length) {
+	const auto zero = _mm_setzero_si128();
+	auto       acc  = _mm_setzero_si128();
+	for (; length >= 16; data += 16, length -= 16) {
+		auto v = _mm_loadu_si128((const __m128i*) data);
+		acc    = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+		acc    = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+	}
+
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i*) lanes, acc);
+	return uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3] + sumScalar(data, length);
+}
+
+__attribute__((target("avx2"))) uint64_t sumAVX2(const unsigned char* data, size_t length) {
+	const auto zero = _mm256_setzero_si256();
+	auto       acc  = _mm256_setzero_si256();
+	for (; length >= 32; data += 32, length -= 32) {
+		auto v = _mm256_loadu_si256((const __m256i*) data);
+		acc    = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+		acc    = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+	}
+
+	uint32_t lanes[8];
+	_mm256_storeu_si256((__m256i*) lanes, acc);
+	uint64_t sum = 0;
+	for (auto lane : lanes) sum += lane;
+	return sum + sumScalar(data, length);
+}
+#endif
+
+struct Implementation {
+	SumFunction sum;
+	const char* name;
+};
+
+Implementation select() {
+#if IGMP_CHECKSUM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return { sumAVX2, "avx2" };
+	if (__builtin_cpu_supports("sse2")) return { sumSSE2, "sse2" };
+#endif
+	return { sumScalar, "scalar" };
+}
+
+const Implementation& implementation() {
+	static const auto chosen = select();
+	return chosen;
+}
+
+}    // namespace
+
+uint16_t computeChecksum(const void* data, size_t length) {
+	auto sum = implementation().sum((const unsigned char*) data, length);
+	sum      = (sum & 0xFFFFFFFF) + (sum >> 32);
+	sum      = (sum & 0xFFFFFFFF) + (sum >> 32);
+	return uint16_t(~foldChecksum(uint32_t(sum)));
+}
+
+const char* checksumImplementation() { return implementation().name; }
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IGMPChecksum)
@@ -0,0 +1,54 @@
+#ifndef CLICK_IGMPCHECKSUM_HH
+#define CLICK_IGMPCHECKSUM_HH
+
+#include <click/glue.hh>
+#include <cstddef>
+#include <cstdint>
+
+CLICK_DECLS
+
+// Incremental internet checksum updates, RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m') for a 16 bit word
+// that changed from m to m'. Fields are passed as they are stored in the packet, the one's
+// complement sum doesn't care about byte order as long as it's the same everywhere.
+// The updates are inline, the full checksum below lives in IGMPChecksum.cc.
+
+// fold the carries of a 32 bit one's complement sum back into 16 bits
+inline uint16_t foldChecksum(uint32_t sum) {
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	return uint16_t(sum);
+}
+
+// checksum after a 16 bit word changed from old to now
+inline uint16_t updateChecksum16(uint16_t checksum, uint16_t old, uint16_t now) {
+	return uint16_t(~foldChecksum(uint32_t(uint16_t(~checksum)) + uint16_t(~old) + now));
+}
+
+// checksum after a 32 bit field, like an address, changed from old to now
+inline uint16_t updateChecksum32(uint16_t checksum, uint32_t old, uint32_t now) {
+	uint32_t sum = uint16_t(~checksum);
+	sum += uint16_t(~old) + uint16_t(~(old >> 16));
+	sum += uint16_t(now) + uint16_t(now >> 16);
+	return uint16_t(~foldChecksum(sum));
+}
+
+// checksum after inserting len bytes (even) into the checksummed data, like an ip option
+inline uint16_t insertChecksum(uint16_t checksum, const void* data, size_t len) {
+	auto     words = (const uint16_t*) data;
+	uint32_t sum   = uint16_t(~checksum);
+	for (size_t i = 0; i < len / 2; i++) sum += words[i];
+	return uint16_t(~foldChecksum(sum));
+}
+
+// Internet checksum over a whole message, the same result as click_in_cksum: 0 when the message
+// holds a valid checksum. Uses AVX2 or SSE2 when the cpu has them, which is picked on the first
+// call, and a scalar loop otherwise. Defined in IGMPChecksum.cc, so users add
+// ELEMENT_REQUIRES(IGMPChecksum).
+uint16_t computeChecksum(const void* data, size_t length);
+
+// name of the implementation computeChecksum uses on this machine
+const char* checksumImplementation();
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPCHECKSUM_HH
@@ -2,9 +2,11 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/timer.hh>
+#include <click/straccum.hh>
 #include <clicknet/ether.h>
-#include <string>
+#include <algorithm>
 #include "IGMPClient.hh"
+#include "IGMPChecksum.hh"
 
 CLICK_DECLS
 /**
@@ -14,15 +16,34 @@ CLICK_DECLS
  * @return
  */
 int IGMPClient::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
 	if (Args(conf, this, errh)
 	        .read_mp("STATE", ElementCastArg("IGMPClientState"), state)
+	        .read("LOGLEVEL", level)
+	        .read("MTU", mtu)
 	        .complete()) {
 		return errh->error("Could not parse IGMPClientState");
 	}
+	if (logger.configure(level, errh) < 0) return -1;
 
-	generalTimer = new Timer(&handleGeneralReport, (void*) this);
-	generalTimer->initialize(this);
+	// the report goes in an IP packet with the router alert option
+	auto overhead = sizeof(click_ip) + sizeof(RouterAlertOption) + sizeof(ReportMessage);
+	if (mtu < overhead + sizeof(GroupRecord)) return errh->error("MTU too small for a report");
+	maxRecords = std::min<uint32_t>((mtu - overhead) / sizeof(GroupRecord), 0xFFFF);
 
+	generalTimer.assign(&handleGeneralReport, this);
+	changeTimer.assign(&handleChangeReport, this);
+
+	return 0;
+}
+
+/**
+ * start the timer wheel
+ * @param errh
+ * @return
+ */
+int IGMPClient::initialize(ErrorHandler* errh) {
+	wheel.initialize(this);
 	return 0;
 }
 
@@ -32,6 +53,51 @@ int IGMPClient::configure(Vector<String>& conf, ErrorHandler* errh) {
 void IGMPClient::add_handlers() {
 	add_write_handler("join", &handleJoin, nullptr);
 	add_write_handler("leave", &handleLeave, nullptr);
+	add_write_handler("joins", &handleBulk, BULK_JOIN);
+	add_write_handler("leaves", &handleBulk, BULK_LEAVE);
+	add_write_handler("set", &handleBulk, BULK_SET);
+	add_read_handler("groups", &readGroups, nullptr);
+	logger.addHandlers(this);
+
+	addCounter(this, "packets_in", stats.packetsIn);
+	addCounter(this, "packets_out", stats.packetsOut);
+	addCounter(this, "drops_no_alert", stats.droppedNoAlert);
+	addCounter(this, "drops_checksum", stats.droppedChecksum);
+	addCounter(this, "drops_type", stats.droppedType);
+	addCounter(this, "drops_truncated", stats.droppedLength);
+	addCounter(this, "queries", stats.queries);
+	addCounter(this, "reports", stats.reports);
+	addCounter(this, "records", stats.records);
+	addCounter(this, "timers_armed", stats.timersArmed);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+	add_read_handler("pending", &readPending, nullptr);
+	add_read_handler("capacity", &readCapacity, nullptr);
+}
+
+/**
+ * read handler for the amount of groups that still have a report to send
+ */
+String IGMPClient::readPending(Element* e, void*) {
+	return String(uint64_t(((IGMPClient*) e)->pending.size()));
+}
+
+/**
+ * read handler for the amount of pending reports there is room for without allocating
+ */
+String IGMPClient::readCapacity(Element* e, void*) {
+	return String(uint64_t(((IGMPClient*) e)->pending.capacity()));
+}
+
+/**
+ * push a report to the output and count it
+ * @param packet the report
+ * @param records amount of group records in the report
+ */
+void IGMPClient::sendReport(Packet* packet, uint32_t records) {
+	stats.packetsOut++;
+	stats.reports++;
+	stats.records += records;
+	output(0).push(packet);
 }
 
 /**
@@ -39,48 +105,64 @@ void IGMPClient::add_handlers() {
  * @param p
  */
 void IGMPClient::push(int, Packet* p) {
+	stats.packetsIn++;
+
+	// the query runs from the ip header to the ip length, which has to be in the packet
+	auto ip    = (const unsigned char*) p->ip_header();
+	auto hlen  = p->ip_header_length();
+	auto total = size_t(ntohs(p->ip_header()->ip_len));
+	if (total < hlen + sizeof(QueryMessage) || ip + total > p->end_data()) {
+		p->kill();
+		stats.droppedLength++;
+		return;
+	}
+
 	RouterAlertOption option{};
-	if (!(p->ip_header_length() > 5 * 4 &&
-	      !memcmp((p->data() + p->ip_header_length() - 4), &option, sizeof(RouterAlertOption)))) {
+	if (!(hlen > 5 * 4 && !memcmp(ip + hlen - 4, &option, sizeof(RouterAlertOption)))) {
 		p->kill();
-		click_chatter("Dropped packet without alert option");
+		stats.droppedNoAlert++;
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped packet without alert option", this);
 		return;
 	}
 
-	auto query = (QueryMessage*) (((const unsigned char*) (((click_ip*) p->data()) + 1)) + 4);
+	auto query = (const QueryMessage*) (ip + hlen);
 
 	if (query->type != QUERY) {
 		p->kill();
+		stats.droppedType++;
 		return;
 	}
 
-	if (click_in_cksum((const unsigned char*) query, sizeof(QueryMessage))) {
+	// the checksum covers the sources of a group and source specific query as well
+	if (computeChecksum(query, total - hlen)) {
 		p->kill();
-		click_chatter("Dropped wrong checksum packet.");
+		stats.droppedChecksum++;
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped packet with wrong checksum", this);
 		return;
 	}
 
+	stats.queries++;
 	unsigned char new_qrv = query->resv_s_qrv & 0x7;
 	qrv = new_qrv ? new_qrv : 2u;
 
 	//	if (!state->hasState()) return;
 	auto delay = (int) (((float) rand() / (float) RAND_MAX) * query->maxRespTime());
 
-	if (generalTimer->scheduled() &&
-	    (generalTimer->expiry_steady() - Timestamp::now_steady()).msecval() < delay) {
+	if (generalPending(IPAddress(query->groupAddress), uint32_t(delay))) {
+		p->kill();
 		return;
 	} else if (query->groupAddress == 0) {
-		generalTimer->schedule_after_msec(delay);
-	} else if (!groupTimers.count(query->groupAddress)) {
-		auto report = new ScheduledGroupReport{ this, query->groupAddress };
-		auto timer  = new Timer(&handleGroupReport, (void*) report);
-		timer->initialize(this);
-		timer->schedule_after_msec(delay);
-		groupTimers[query->groupAddress] = timer;
-	} else if ((groupTimers[query->groupAddress]->expiry_steady() - Timestamp::now_steady())
-	               .msecval() > delay) {
-		groupTimers[query->groupAddress]->schedule_after_msec(delay);
+		wheel.schedule(&generalTimer, delay);
+		generalWindow = query->maxRespTime() - delay;
+		stats.timersArmed++;
+
+		// a response that is already running spreads the reports it has left over the new window
+		if (generalNext < generalGroups.size())
+			generalInterval = generalWindow / reportsFor(generalGroups.size() - generalNext);
+	} else {
+		scheduleGroupReport(query->groupAddress, delay);
 	}
+	p->kill();
 }
 
 /**
@@ -138,166 +220,398 @@ int IGMPClient::handleLeave(const String& conf, Element* e, void* thunk, ErrorHa
 }
 
 /**
- * schedule an unsolicited interface change report
+ * parse a list of groups separated by spaces or commas, an entry can also be a prefix like
+ * 225.1.0.0/24 which stands for every address in it
+ * @param conf
+ * @param groups the parsed groups are appended to this
+ * @param errh
+ * @return 0 or an error
+ */
+int IGMPClient::parseGroups(const String& conf, std::vector<IPAddress>& groups,
+                            ErrorHandler* errh) {
+	Vector<String> args;
+	cp_argvec(conf, args);
+
+	for (const auto& arg : args) {
+		Vector<String> words;
+		cp_spacevec(arg, words);
+
+		for (const auto& word : words) {
+			IPAddress address, mask;
+			if (!IPPrefixArg(true).parse(word, address, mask)) {
+				return errh->error("Could not parse multicast-address %s", word.c_str());
+			}
+
+			auto first = ntohl(address.addr() & mask.addr());
+			auto last  = first | ~ntohl(mask.addr());
+			if (groups.size() + (last - first) >= MAX_BULK) {
+				return errh->error("%s takes the write past %u addresses", word.c_str(),
+				                   MAX_BULK);
+			}
+
+			for (auto i = uint64_t(first); i <= last; i++) {
+				auto group = IPAddress(htonl(uint32_t(i)));
+				if (!group.is_multicast()) {
+					return errh->error("%s is not a multicast-address", group.unparse().c_str());
+				}
+				groups.push_back(group);
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * handler for the joins, leaves and set commands. Everything is parsed before anything changes,
+ * so a bad entry leaves the state untouched. The resulting state changes are sent together.
+ * @param conf list of groups
+ * @param e
+ * @param thunk BULK_JOIN, BULK_LEAVE or BULK_SET
+ * @param errh
+ * @return
+ */
+int IGMPClient::handleBulk(const String& conf, Element* e, void* thunk, ErrorHandler* errh) {
+	auto client = (IGMPClient*) e;
+
+	std::vector<IPAddress> groups;
+	if (parseGroups(conf, groups, errh) < 0) return -1;
+
+	switch ((intptr_t) thunk) {
+	case BULK_JOIN:
+		for (auto group : groups) {
+			if (client->state->addAddress(group))
+				client->scheduleStateChangeMessage(CHANGE_TO_EXCLUDE_MODE, group);
+		}
+		break;
+	case BULK_LEAVE:
+		for (auto group : groups) {
+			if (client->state->removeAddress(group))
+				client->scheduleStateChangeMessage(CHANGE_TO_INCLUDE_MODE, group);
+		}
+		break;
+	case BULK_SET: {
+		// leave everything that isn't in the new set, then join the rest
+		auto less = [](IPAddress a, IPAddress b) { return a.addr() < b.addr(); };
+		std::sort(groups.begin(), groups.end(), less);
+
+		std::vector<IPAddress> current(client->state->begin(), client->state->end());
+		for (auto group : current) {
+			if (std::binary_search(groups.begin(), groups.end(), group, less)) continue;
+			if (client->state->removeAddress(group))
+				client->scheduleStateChangeMessage(CHANGE_TO_INCLUDE_MODE, group);
+		}
+		for (auto group : groups) {
+			if (client->state->addAddress(group))
+				client->scheduleStateChangeMessage(CHANGE_TO_EXCLUDE_MODE, group);
+		}
+		break;
+	}
+	}
+
+	return 0;
+}
+
+/**
+ * read handler for the joined groups, one per line in ascending order
+ */
+String IGMPClient::readGroups(Element* e, void*) {
+	auto client = (IGMPClient*) e;
+
+	std::vector<IPAddress> groups(client->state->begin(), client->state->end());
+	std::sort(groups.begin(), groups.end(),
+	          [](IPAddress a, IPAddress b) { return ntohl(a.addr()) < ntohl(b.addr()); });
+
+	StringAccum sa;
+	for (auto group : groups) sa << group.unparse() << '\n';
+	return sa.take_string();
+}
+
+/**
+ * get the pending report of a group, take one from the pool if there is none yet
+ * @param address groupaddress
+ * @return
+ */
+IGMPClient::PendingReport* IGMPClient::acquire(IPAddress address) {
+	// a new entry starts from a default PendingReport
+	auto  created = false;
+	auto& report  = pending.insert(address, &created);
+	if (!created) return &report;
+
+	report.client  = this;
+	report.address = address;
+	report.timer.assign(&handlePendingReport, &report);
+	return &report;
+}
+
+/**
+ * give a pending report back to the pool
+ * @param report
+ */
+void IGMPClient::release(PendingReport* report) {
+	// erasing destroys the report, so the address is copied first
+	auto address = report->address;
+	wheel.unschedule(&report->timer);
+	pending.erase(address);
+}
+
+/**
+ * schedule an unsolicited interface change report, changes that are made together end up in the
+ * same report
  * @param type type of the record
  * @param address groupaddress
  */
 void IGMPClient::scheduleStateChangeMessage(RecordType type, IPAddress address) {
-	auto packet = Packet::make(sizeof(click_ether) + sizeof(click_ip), 0,
-	                           sizeof(ReportMessage) + sizeof(GroupRecord), 0);
+	// a new change replaces the retransmissions of the previous one
+	auto report         = acquire(address);
+	report->changeType  = type;
+	report->changesLeft = std::max(qrv, 1u);
+
+	if (!report->changing) {
+		report->changing = true;
+		changes.push_back(report);
+	}
 
-	if (!packet) {
-		click_chatter("Could not allocate packet");
-		return;
+	// the first transmission should go out right away, this also picks up any other changes that
+	// are made before the timer runs
+	if (!changeTimer.scheduled() || wheel.remainingMsec(&changeTimer) > wheel.tick()) {
+		wheel.schedule(&changeTimer, 0);
+		stats.timersArmed++;
 	}
-	memset(packet->data(), 0, packet->length());
+}
 
-	auto header             = (ReportMessage*) packet->data();
-	header->type            = REPORT;
-	header->NumGroupRecords = htons(1);
+/**
+ * send one round of every pending state change, merged into as few reports as possible
+ * @param timer
+ * @param data IGMPClient
+ */
+void IGMPClient::handleChangeReport(WheelTimer* timer, void* data) {
+	auto client = (IGMPClient*) data;
+	auto iter   = client->changes.begin();
 
-	auto record              = (GroupRecord*) (header + 1);
-	record->recordType       = type;
-	record->multicastAddress = address.in_addr();
+	while (iter != client->changes.end()) {
+		auto count  = std::min<size_t>(client->changes.end() - iter, client->maxRecords);
+		auto packet = client->makeReport(count);
+		if (!packet) break;
 
-	header->checksum =
-		click_in_cksum((const unsigned char*) header, sizeof(ReportMessage) + sizeof(GroupRecord));
+		auto record = (GroupRecord*) (packet->data() + sizeof(ReportMessage));
+		for (auto end = iter + count; iter != end; ++iter, ++record) {
+			*record = GroupRecord{ (*iter)->changeType, 0, 0, (*iter)->address.in_addr() };
+			(*iter)->changesLeft--;
+		}
+		client->finishReport(packet, "Interface Change");
+	}
 
-	output(0).push(packet->clone());
-	printMessage("Interface Change: " + std::to_string(qrv - 1) + " remaining", header);
+	// keep the groups that still have retransmissions left
+	size_t kept = 0;
+	for (auto report : client->changes) {
+		if (report->changesLeft) {
+			client->changes[kept++] = report;
+			continue;
+		}
+		report->changing = false;
+		if (!report->queryResponse) client->release(report);
+	}
+	client->changes.resize(kept);
 
-	auto iter = changeTimers.find(address);
-	if (iter != changeTimers.end()) {
-		(*iter).second->clear();
-		delete (*iter).second;
+	if (!client->changes.empty()) {
+		client->wheel.schedule(timer, (float) rand() / (float) RAND_MAX *
+		                                  client->unsolicitedReportInterval);
+		client->stats.timersArmed++;
 	}
+}
+
+/**
+ * schedule the response to a group specific query, unless an earlier report is already planned
+ * @param address groupaddress
+ * @param delay in msec
+ */
+void IGMPClient::scheduleGroupReport(IPAddress address, uint32_t delay) {
+	if (!state->hasAddress(address) || address == ALL_SYSTEMS) return;
 
-	if (qrv <= 1) return;
+	auto report           = acquire(address);
+	report->queryResponse = true;
 
-	auto timerdata = new ScheduledChangeReport{ this, packet, qrv - 1 };
-	auto timer     = new Timer(&handleChangeReport, timerdata);
-	timer->initialize(this);
-	timer->schedule_after_msec((float) rand() / (float) RAND_MAX * unsolicitedReportInterval);
-	changeTimers[address] = timer;
+	if (!report->timer.scheduled() || wheel.remainingMsec(&report->timer) > delay) {
+		wheel.schedule(&report->timer, delay);
+		stats.timersArmed++;
+	}
 }
 
 /**
- * send an unsolicited interface change report
+ * send what is pending for a group: a state change retransmission or a query response
  * @param timer
- * @param data ScheduledChangeReport
+ * @param data PendingReport
  */
-void IGMPClient::handleChangeReport(Timer* timer, void* data) {
-	auto* report = (ScheduledChangeReport*) data;
-	assert(report);
-	report->client->output(0).push(report->packet->clone());
-	printMessage("Interface Change: " + std::to_string(report->remaining - 1) + " remaining",
-	             (ReportMessage*) report->packet->data());
-	if (--report->remaining <= 0) {
-		timer->clear();
-		return;
-	}
-	timer->schedule_after_msec((float) rand() / (float) RAND_MAX *
-	                           report->client->unsolicitedReportInterval);
+void IGMPClient::handlePendingReport(WheelTimer* timer, void* data) {
+	auto report = (PendingReport*) data;
+	auto client = report->client;
+
+	// a pending state change record also answers the query for this group
+	if (!report->changesLeft && client->state->hasAddress(report->address))
+		client->sendRecord(MODE_IS_EXCLUDE, report->address);
+
+	report->queryResponse = false;
+	if (!report->changing) client->release(report);
 }
 
 /**
- * send a general report message
- * @param timer to expire
- * @param data IGMPClient
+ * build and send a report with a single group record
+ * @param type type of the record
+ * @param address groupaddress
  */
-void IGMPClient::handleGeneralReport(Timer* timer, void* data) {
-	auto client = (IGMPClient*) data;
-	assert(client);
-	timer->clear();
+void IGMPClient::sendRecord(RecordType type, IPAddress address) {
+	auto packet = makeReport(1);
+	if (!packet) return;
+
+	auto record = (GroupRecord*) (packet->data() + sizeof(ReportMessage));
+	*record     = GroupRecord{ type, 0, 0, address.in_addr() };
 
-	if (!client->state->hasState()) return;
+	finishReport(packet, "Group");
+}
 
-	auto packet =
-		Packet::make(sizeof(click_ether) + sizeof(click_ip), 0,
-	                 sizeof(ReportMessage) + sizeof(GroupRecord) * client->state->size(), 0);
+/**
+ * allocate a report with room for a number of records, the caller fills in every record
+ * @param records amount of group records
+ * @return the packet or nullptr if it could not be allocated
+ */
+WritablePacket* IGMPClient::makeReport(uint32_t records) {
+	auto length = sizeof(ReportMessage) + sizeof(GroupRecord) * records;
+	auto packet = Packet::make(sizeof(click_ether) + sizeof(click_ip) + sizeof(RouterAlertOption),
+	                           0, length, 0);
 	if (!packet) {
-		click_chatter("Could not allocate packet");
-		return;
+		IGMP_LOG(logger, ERROR, "%p{element}: could not allocate packet", this);
+		return nullptr;
 	}
-	memset(packet->data(), 0, packet->length());
 
+	// the records themselves are written completely by the caller, so they aren't cleared here
 	auto header             = (ReportMessage*) packet->data();
+	*header                 = ReportMessage{};
 	header->type            = REPORT;
-	header->NumGroupRecords = htons(client->state->size());
+	header->NumGroupRecords = htons(records);
+
+	return packet;
+}
+
+/**
+ * checksum a report and send it
+ * @param packet made by makeReport
+ * @param front description for the debug log
+ */
+void IGMPClient::finishReport(WritablePacket* packet, const char* front) {
+	auto header      = (ReportMessage*) packet->data();
+	header->checksum = computeChecksum(packet->data(), packet->length());
+
+	if (logger.enabled(LogLevel::DEBUG)) printMessage(front, header);
+	sendReport(packet, ntohs(header->NumGroupRecords));
+}
 
-	auto record = (GroupRecord*) (header + 1);
-	for (const auto& address : *client->state) {
-		record->recordType       = MODE_IS_EXCLUDE;
-		record->multicastAddress = address.in_addr();
-		record++;
+/**
+ * check if the pending general response still covers a group
+ * @param group asked for, 0.0.0.0 for a general query
+ * @param delay of the response that would be scheduled otherwise
+ * @return
+ */
+bool IGMPClient::generalPending(IPAddress group, uint32_t delay) const {
+	if (!generalTimer.scheduled()) return false;
+	auto next = wheel.remainingMsec(&generalTimer);
+	if (next >= delay) return false;
+	if (!group) return true;
+
+	// Before the first report the response is taken from the state when the timer fires, in the
+	// state's order and spread over the whole window. After it only the groups not sent yet are
+	// ahead, at the interval of the running response.
+	size_t   position = 0;
+	uint32_t interval = generalInterval;
+	if (generalNext >= generalGroups.size()) {
+		auto found = std::find(state->begin(), state->end(), group);
+		if (found == state->end()) return false;
+		position = size_t(std::distance(state->begin(), found));
+		interval = generalWindow / reportsFor(state->size());
+	} else {
+		auto ahead = generalGroups.begin() + generalNext;
+		auto found = std::find(ahead, generalGroups.end(), group);
+		if (found == generalGroups.end()) return false;
+		position = size_t(found - ahead);
 	}
 
-	header->checksum =
-		click_in_cksum((const unsigned char*) header,
-	                   sizeof(ReportMessage) + sizeof(GroupRecord) * client->state->size());
-	client->output(0).push(packet);
-	printMessage("General", header);
+	// the reports that come before the one holding the group follow each other at the interval
+	return next + (position / maxRecords) * interval < delay;
 }
 
 /**
- * send a Group specific report message
- * @param timer that expires
- * @param data ScheduledGroupReport
+ * send the next report of the response to a general query
+ * @param timer to expire
+ * @param data IGMPClient
  */
-void IGMPClient::handleGroupReport(Timer* timer, void* data) {
-	auto report = (ScheduledGroupReport*) data;
-	assert(report);
+void IGMPClient::handleGeneralReport(WheelTimer* timer, void* data) {
+	auto client = (IGMPClient*) data;
+	assert(client);
+	auto& groups = client->generalGroups;
 
-	timer->clear();
-	delete timer;
-	report->client->groupTimers.erase(report->address);
+	// start a new response from the current state
+	if (client->generalNext >= groups.size()) {
+		groups.assign(client->state->begin(), client->state->end());
+		client->generalNext = 0;
+		if (groups.empty()) return;
 
-	if (!report->client->state->hasAddress(report->address) ||
-	    report->address == IPAddress("224.0.0.1"))
-		return;
+		client->generalInterval = client->generalWindow / client->reportsFor(groups.size());
+	}
 
-	auto packet = Packet::make(sizeof(click_ether) + sizeof(click_ip), 0,
-	                           sizeof(ReportMessage) + sizeof(GroupRecord), 0);
+	auto count  = std::min<size_t>(groups.size() - client->generalNext, client->maxRecords);
+	auto packet = client->makeReport(count);
 	if (!packet) {
-		click_chatter("Could not allocate packet");
+		groups.clear();
 		return;
 	}
-	memset(packet->data(), 0, packet->length());
-
-	auto header             = (ReportMessage*) packet->data();
-	header->type            = REPORT;
-	header->NumGroupRecords = htons(1);
 
-	auto record              = (GroupRecord*) (header + 1);
-	record->recordType       = MODE_IS_EXCLUDE;
-	record->multicastAddress = report->address;
+	// groups left since the response started are skipped, the report is trimmed to fit
+	auto     record  = (GroupRecord*) (packet->data() + sizeof(ReportMessage));
+	uint32_t written = 0;
+	for (size_t i = 0; i < count; i++) {
+		auto address = groups[client->generalNext + i];
+		if (!client->state->hasAddress(address)) continue;
+		record[written++] = GroupRecord{ MODE_IS_EXCLUDE, 0, 0, address.in_addr() };
+	}
+	client->generalNext += count;
+
+	if (written) {
+		packet->take((count - written) * sizeof(GroupRecord));
+		((ReportMessage*) packet->data())->NumGroupRecords = htons(written);
+		client->finishReport(packet, "General");
+	} else {
+		packet->kill();
+	}
 
-	header->checksum =
-		click_in_cksum((const unsigned char*) header, sizeof(ReportMessage) + sizeof(GroupRecord));
-	report->client->output(0).push(packet);
-	printMessage("Group", header);
+	if (client->generalNext < groups.size()) {
+		client->wheel.schedule(timer, client->generalInterval);
+		client->stats.timersArmed++;
+	} else {
+		groups.clear();
+	}
 }
 
 /**
- * print the content of a report message
+ * print the content of a report message, only call this when debug logging is enabled
  * @param front text to put in front
  * @param message
  */
-void printMessage(std::string front, ReportMessage* message) {
-	click_chatter("%s:\treport", front.c_str());
+void printMessage(const char* front, const ReportMessage* message) {
+	click_chatter("%s:\treport", front);
 	for (uint16_t i = 0; i < ntohs(message->NumGroupRecords); ++i) {
-		auto        record = (GroupRecord*) (message + 1) + i;
-		std::string type;
+		auto        record = (const GroupRecord*) (message + 1) + i;
+		const char* type   = "unknown";
 		switch (record->recordType) {
 		case MODE_IS_INCLUDE: type = "is_inc"; break;
 		case MODE_IS_EXCLUDE: type = "is_exc"; break;
 		case CHANGE_TO_INCLUDE_MODE: type = "to_inc"; break;
 		case CHANGE_TO_EXCLUDE_MODE: type = "to_exc"; break;
+		case ALLOW_NEW_SOURCES: type = "allow"; break;
+		case BLOCK_OLD_SOURCES: type = "block"; break;
 		}
-		click_chatter("\t%s %s", type.c_str(),
-		              IPAddress(record->multicastAddress).unparse().c_str());
+		click_chatter("\t%s %s", type, IPAddress(record->multicastAddress).unparse().c_str());
 	}
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IGMPTimerWheel IGMPChecksum)
 EXPORT_ELEMENT(IGMPClient)
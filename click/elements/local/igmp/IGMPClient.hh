@@ -4,8 +4,11 @@
 #include <click/element.hh>
 #include "IGMPMessages.hh"
 #include "IGMPClientState.hh"
-#include <string>
-#include <unordered_map>
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
+#include "IGMPTimerWheel.hh"
+#include "IGMPAddressMap.hh"
+#include <vector>
 
 CLICK_DECLS
 class IGMPClient: public Element {
@@ -15,6 +18,7 @@ public:
 	const char* processing() const override { return PUSH; }
 
 	int  configure(Vector<String>&, ErrorHandler*) override;
+	int  initialize(ErrorHandler*) override;
 	void add_handlers() override;
 
 	void push(int, Packet*) override;
@@ -22,33 +26,110 @@ public:
 	static int handleJoin(const String& conf, Element* e, void* thunk, ErrorHandler* errh);
 	static int handleLeave(const String& conf, Element* e, void* thunk, ErrorHandler* errh);
 
+	// joins, leaves and set: lists and prefixes of groups in one call
+	static int handleBulk(const String& conf, Element* e, void* thunk, ErrorHandler* errh);
+
+	static String readGroups(Element* e, void* thunk);
+
 	void scheduleStateChangeMessage(RecordType type, IPAddress address);
 
 private:
+	enum { BULK_JOIN, BULK_LEAVE, BULK_SET };
+
+	// most addresses one joins, leaves or set write may list, its prefixes expanded
+	static constexpr uint32_t MAX_BULK = 1 << 16;
+
+	static int parseGroups(const String& conf, std::vector<IPAddress>& groups,
+	                       ErrorHandler* errh);
+
 	IGMPClientState* state;
+	IGMPLogger       logger;
 	uint32_t         qrv                       = 2;
 	const uint32_t   unsolicitedReportInterval = 1000;
 
-	Timer*                                      generalTimer;
-	std::unordered_map<IPAddress, Timer*, Hash> groupTimers;
-	std::unordered_map<IPAddress, Timer*, Hash> changeTimers;
+	// reports are split so their IP packet fits in the MTU
+	uint32_t mtu        = 1500;
+	uint32_t maxRecords = 0;
 
-	struct ScheduledChangeReport {
-		IGMPClient* client;
-		Packet*     packet;
-		uint32_t    remaining;
-	};
+	struct Stats {
+		uint64_t packetsIn       = 0;
+		uint64_t packetsOut      = 0;
+		uint64_t droppedNoAlert  = 0;
+		uint64_t droppedChecksum = 0;
+		uint64_t droppedType     = 0;
+		uint64_t droppedLength   = 0;
+		uint64_t queries         = 0;
+		uint64_t reports         = 0;
+		uint64_t records         = 0;
+		uint64_t timersArmed     = 0;
+	} stats;
 
-	struct ScheduledGroupReport {
-		IGMPClient* client;
+	// Everything a group still has to send: the transmissions of its last state change and/or
+	// the response to a group specific query. There is at most one of these per group.
+	// The timer is only used for the query response, state changes share the change timer.
+	struct PendingReport {
+		IGMPClient* client = nullptr;
 		IPAddress   address;
+		WheelTimer  timer;
+		RecordType  changeType    = CHANGE_TO_EXCLUDE_MODE;
+		uint32_t    changesLeft   = 0;
+		bool        queryResponse = false;
+		bool        changing      = false;    // in the changes list
 	};
 
-	static void handleChangeReport(Timer* timer, void* data);
-	static void handleGeneralReport(Timer* timer, void* data);
-	static void handleGroupReport(Timer* timer, void* data);
+	// group address -> pending report. The map keeps its entries at a fixed address and reuses
+	// the place of an erased one, so joins and leaves don't allocate once it has grown.
+	// Declared before the wheel so the entries outlive it.
+	AddressMap<PendingReport> pending;
+
+	// groups with state change records left to send, merged into shared reports
+	std::vector<PendingReport*> changes;
+
+	// The response to a general query is split in reports that fit the MTU, these go out one by
+	// one, spread over what is left of the query's response interval.
+	WheelTimer             generalTimer;
+	std::vector<IPAddress> generalGroups;
+	size_t                 generalNext     = 0;
+	uint32_t               generalWindow   = 0;
+	uint32_t               generalInterval = 0;
+
+	WheelTimer changeTimer;
+
+	// drives the general timer and every pending report with a single Click timer
+	TimerWheel wheel{ 10 };
+
+	PendingReport* acquire(IPAddress address);
+	void           release(PendingReport* report);
+
+	void scheduleGroupReport(IPAddress address, uint32_t delay);
+
+	// reports needed for a general response with this many groups
+	size_t reportsFor(size_t groups) const { return (groups + maxRecords - 1) / maxRecords; }
+
+	// true if the response to a general query that is in progress reports the group (any group
+	// for 0.0.0.0) sooner than delay, a query for it needs no answer of its own then
+	bool generalPending(IPAddress group, uint32_t delay) const;
+
+	// build and send a report with a single record
+	void sendRecord(RecordType type, IPAddress address);
+
+	// allocate a report with room for n records, everything but the records and checksum is set
+	WritablePacket* makeReport(uint32_t records);
+
+	// checksum a report made with makeReport and send it
+	void finishReport(WritablePacket* packet, const char* front);
+
+	// push a report and count it
+	void sendReport(Packet* packet, uint32_t records);
+
+	static String readPending(Element* e, void* thunk);
+	static String readCapacity(Element* e, void* thunk);
+
+	static void handlePendingReport(WheelTimer* timer, void* data);
+	static void handleChangeReport(WheelTimer* timer, void* data);
+	static void handleGeneralReport(WheelTimer* timer, void* data);
 };
 
-void printMessage(std::string front, ReportMessage* message);
+void printMessage(const char* front, const ReportMessage* message);
 CLICK_ENDDECLS
 #endif    // IGMPCLIENT_H
\ No newline at end of file
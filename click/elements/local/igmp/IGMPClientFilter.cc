@@ -12,26 +12,58 @@ CLICK_DECLS
  * @return
  */
 int IGMPClientFilter::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
 	if (Args(conf, this, errh)
 	        .read_mp("STATE", ElementCastArg("IGMPClientState"), state)
+	        .read("LOGLEVEL", level)
 	        .complete()) {
 		return errh->error("Could not parse IGMPClientState");
 	}
 
-	return 0;
+	return logger.configure(level, errh);
 }
 
 /**
- * forward the packet to port 0 if it's required by the IGMPClientState
+ * register handlers
+ */
+void IGMPClientFilter::add_handlers() {
+	logger.addHandlers(this);
+
+	addCounter(this, "packets_in", stats.packetsIn);
+	addCounter(this, "accepted", stats.accepted);
+	addCounter(this, "rejected", stats.rejected);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+}
+
+/**
+ * forward the packet to port 0 if it's required by the IGMPClientState, to port 1 otherwise
  * @param port
  * @param p
  */
 void IGMPClientFilter::push(int port, Packet* p) {
-	if (state->hasAddress(p->dst_ip_anno())) {
+	if (classify(p) == 0) {
 		output(0).push(p);
+	} else if (noutputs() > 1) {
+		output(1).push(p);
+	} else {
+		p->kill();
 	}
-	output(1).push(p);
 }
+
+#if HAVE_BATCH
+/**
+ * classify a whole batch against the IGMPClientState in one pass, then pass each part on as a
+ * batch of its own
+ * @param port
+ * @param batch
+ */
+void IGMPClientFilter::push_batch(int port, PacketBatch* batch) {
+	// without output 1 the rejected part is killed by checked_output_push_batch
+	auto fnt = [this](Packet* p) { return classify(p); };
+	CLASSIFY_EACH_PACKET(2, fnt, batch, checked_output_push_batch);
+}
+#endif
+
 CLICK_ENDDECLS
 
 EXPORT_ELEMENT(IGMPClientFilter)
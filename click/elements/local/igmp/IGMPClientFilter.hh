@@ -3,20 +3,47 @@
 
 #include <click/element.hh>
 #include "IGMPClientState.hh"
+#include "IGMPBatch.hh"
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
 CLICK_DECLS
 
-class IGMPClientFilter: public Element {
+// Output 0 gets the packets for joined groups, the optional output 1 the rest.
+// Every packet goes to exactly one output, without output 1 the rest is dropped here.
+class IGMPClientFilter: public IGMPBatchElement {
 public:
 	const char* class_name() const override { return "IGMPClientFilter"; }
-	const char* port_count() const override { return "1/2"; }
+	const char* port_count() const override { return "1/1-2"; }
 	const char* processing() const override { return PUSH; }
 
-	int configure(Vector<String>&, ErrorHandler*) override;
+	int  configure(Vector<String>&, ErrorHandler*) override;
+	void add_handlers() override;
 
 	void push(int port, Packet* p) override;
+#if HAVE_BATCH
+	void push_batch(int port, PacketBatch* batch) override;
+#endif
 
 private:
 	IGMPClientState* state;
+	IGMPLogger       logger;
+
+	struct Stats {
+		uint64_t packetsIn = 0;
+		uint64_t accepted  = 0;
+		uint64_t rejected  = 0;
+	} stats;
+
+	// the output a packet belongs on
+	inline int classify(Packet* p) {
+		stats.packetsIn++;
+		if (state->hasAddress(p->dst_ip_anno())) {
+			stats.accepted++;
+			return 0;
+		}
+		stats.rejected++;
+		return 1;
+	}
 };
 
 CLICK_ENDDECLS
@@ -12,8 +12,8 @@ CLICK_DECLS
  * @return True if newly joined
  */
 bool IGMPClientState::addAddress(IPAddress address) {
-	if (address == IPAddress("224.0.0.1")) return false;
-	return addresses.insert(address).second;
+	if (address == ALL_SYSTEMS) return false;
+	return addresses.insert(address);
 }
 
 /**
@@ -23,16 +23,6 @@ bool IGMPClientState::addAddress(IPAddress address) {
  */
 bool IGMPClientState::removeAddress(IPAddress address) { return addresses.erase(address); }
 
-/**
- * check if address has been joined
- * @param address
- * @return
- */
-bool IGMPClientState::hasAddress(IPAddress address) const {
-	if (address == IPAddress("224.0.0.1")) return true;
-	return addresses.count(address);
-}
-
 /**
  * check if any address has been joined
  * @return
@@ -2,12 +2,9 @@
 #define IGMPCLIENTSTATE_HH
 
 #include <click/element.hh>
-#include <vector>
-#include <unordered_set>
+#include "IGMPAddressSet.hh"
+#include "IGMPMessages.hh"
 CLICK_DECLS
-struct Hash {
-	size_t operator()(const IPAddress& address) const { return address.addr(); }
-};
 
 class IGMPClientState: public Element {
 public:
@@ -18,22 +15,26 @@ public:
 
 	bool removeAddress(IPAddress address);
 
-	bool hasAddress(IPAddress address) const;
+	// check if address has been joined, inline because the filter calls it for every packet
+	bool hasAddress(IPAddress address) const {
+		if (address == ALL_SYSTEMS) return true;
+		return addresses.contains(address);
+	}
 
 	bool hasState() const;
 
 	size_t size() const;
 
-	typedef std::unordered_set<IPAddress, Hash>::const_iterator const_iterator;
-	const_iterator begin() { return addresses.begin(); }
-	const_iterator end() { return addresses.end(); }
+	typedef AddressSet::const_iterator const_iterator;
+	const_iterator begin() const { return addresses.begin(); }
+	const_iterator end() const { return addresses.end(); }
 
 private:
 	// RFC-3.2: interface state
 	// state is only a set because the client has only one interface and socket and the source-list
 	// is always empty addresses in the set have EXCLUDE {} addresses outside the set have INCLUDE
 	// {}
-	std::unordered_set<IPAddress, Hash> addresses;
+	AddressSet addresses;
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,92 @@
+#include <click/config.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <clicknet/ip.h>
+#include "IGMPEncap.hh"
+#include "IGMPMessages.hh"
+
+CLICK_DECLS
+int IGMPEncap::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
+	if (Args(conf, this, errh)
+	        .read_mp("SRC", source)
+	        .read("TTL", ttl)
+	        .read("TOS", tos)
+	        .read("LOGLEVEL", level)
+	        .complete() < 0)
+		return -1;
+	return logger.configure(level, errh);
+}
+
+void IGMPEncap::add_handlers() {
+	logger.addHandlers(this);
+
+	addCounter(this, "packets", stats.packets);
+	addCounter(this, "queries", stats.queries);
+	addCounter(this, "reports", stats.reports);
+	addCounter(this, "drops", stats.dropped);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+}
+
+IPAddress IGMPEncap::destination(const Packet* packet) {
+	if (packet->length() >= sizeof(QueryMessage) && packet->data()[0] == QUERY) {
+		auto group = ((const QueryMessage*) packet->data())->groupAddress;
+		return group.s_addr ? IPAddress(group) : ALL_SYSTEMS;
+	}
+	if (packet->length() >= sizeof(ReportMessage) && packet->data()[0] == REPORT) {
+		return ALL_REPORTS;
+	}
+	return IPAddress();
+}
+
+void IGMPEncap::push(int, Packet* p) {
+	stats.packets++;
+
+	auto dest = destination(p);
+	if (dest.empty()) {
+		IGMP_LOG(logger, WARNING, "%p{element}: dropped packet that isn't a query or report", this);
+		p->kill();
+		stats.dropped++;
+		return;
+	}
+	if (dest == ALL_REPORTS) {
+		stats.reports++;
+	} else {
+		stats.queries++;
+	}
+
+	// the messages are made with room for this, so nothing is copied
+	const auto option = RouterAlertOption{};
+	const auto length = sizeof(click_ip) + sizeof(option);
+
+	auto packet = p->push(length);
+	if (!packet) {
+		IGMP_LOG(logger, ERROR, "%p{element}: could not allocate packet", this);
+		stats.dropped++;
+		return;
+	}
+
+	auto ip    = (click_ip*) packet->data();
+	ip->ip_v   = 4;
+	ip->ip_hl  = length >> 2;
+	ip->ip_tos = tos;
+	ip->ip_len = htons(packet->length());
+	ip->ip_id  = htons(id++);
+	ip->ip_off = 0;
+	ip->ip_ttl = ttl;
+	ip->ip_p   = IP_PROTO_IGMP;
+	ip->ip_sum = 0;
+	ip->ip_src = source.in_addr();
+	ip->ip_dst = dest.in_addr();
+	memcpy(ip + 1, &option, sizeof(option));
+
+	// the header is final, so this is the only checksum that is computed
+	ip->ip_sum = click_in_cksum((unsigned char*) ip, int(length));
+
+	packet->set_ip_header(ip, length);
+	packet->set_dst_ip_anno(dest);
+	output(0).push(packet);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IGMPEncap)
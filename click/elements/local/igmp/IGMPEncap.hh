@@ -0,0 +1,48 @@
+#ifndef CLICK_IGMPENCAP_HH
+#define CLICK_IGMPENCAP_HH
+
+#include <click/element.hh>
+#include <click/ipaddress.hh>
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
+
+CLICK_DECLS
+
+// Puts an IGMP message from IGMPRouter or IGMPClient in an IPv4 packet with the router alert option
+// in one pass, replacing IPEncap -> AlertEncap -> FixIPDest. Queries go to their group, or to
+// 224.0.0.1 when they are general, reports go to 224.0.0.22. The header is written in the
+// headroom of the message and its checksum is computed once.
+//
+// IGMPEncap(SRC [, TTL, TOS, LOGLEVEL])
+class IGMPEncap: public Element {
+public:
+	const char* class_name() const override { return "IGMPEncap"; }
+	const char* port_count() const override { return "1/1"; }
+	const char* processing() const override { return PUSH; }
+
+	int  configure(Vector<String>&, ErrorHandler*) override;
+	void add_handlers() override;
+
+	void push(int, Packet*) override;
+
+private:
+	// the destination for the message in the packet, 0.0.0.0 if it isn't a query or report
+	static IPAddress destination(const Packet* packet);
+
+	IPAddress source;
+	uint8_t   ttl = 1;
+	uint8_t   tos = 0xc0;
+	uint16_t  id  = 0;
+
+	IGMPLogger logger;
+
+	struct Stats {
+		uint64_t packets = 0;
+		uint64_t queries = 0;
+		uint64_t reports = 0;
+		uint64_t dropped = 0;
+	} stats;
+};
+
+CLICK_ENDDECLS
+#endif    // CLICK_IGMPENCAP_HH
@@ -0,0 +1,96 @@
+#include <click/config.h>
+#include "IGMPForwarding.hh"
+
+CLICK_DECLS
+
+ForwardingTable::ForwardingTable() {
+	auto view = new ForwardingView();
+	for (auto& shard : view->shards) shard = new Forwarding();
+	current.store(view);
+}
+
+ForwardingTable::~ForwardingTable() {
+	// the readers are gone by now
+	for (auto& r : retired) {
+		for (auto shard : r.shards) delete shard;
+		delete r.view;
+	}
+	auto view = current.load();
+	for (auto shard : view->shards) delete shard;
+	delete view;
+}
+
+void ForwardingTable::set(IPAddress group, GroupForwarding&& entry) {
+	if (entry.empty()) {
+		erase(group);
+		return;
+	}
+
+	// a refresh that ends up where it started doesn't cost a publish
+	auto  shard = ForwardingView::shard(group);
+	auto& slot  = master[shard][group.addr()];
+	if (slot == entry) return;
+
+	slot = std::move(entry);
+	dirty |= uint64_t(1) << shard;
+}
+
+void ForwardingTable::erase(IPAddress group) {
+	auto shard = ForwardingView::shard(group);
+	if (master[shard].erase(group.addr())) dirty |= uint64_t(1) << shard;
+}
+
+size_t ForwardingTable::size() const {
+	size_t result = 0;
+	for (const auto& shard : master) result += shard.size();
+	return result;
+}
+
+uint32_t ForwardingTable::addReader() {
+	readers.emplace_back();
+	return uint32_t(readers.size() - 1);
+}
+
+void ForwardingTable::publish() {
+	if (dirty) {
+		// the new view shares every shard that didn't change with the old one
+		auto    old  = current.load(std::memory_order_relaxed);
+		auto    view = new ForwardingView(*old);
+		Retired replaced{ old, {}, 0 };
+		for (auto bits = dirty; bits; bits &= bits - 1) {
+			auto shard          = __builtin_ctzll(bits);
+			view->shards[shard] = new Forwarding(master[shard]);
+			replaced.shards.push_back(old->shards[shard]);
+		}
+		current.exchange(view, std::memory_order_seq_cst);
+
+		// readers that load the epoch from here on find the new view
+		replaced.epoch = epoch.fetch_add(1, std::memory_order_seq_cst);
+		retired.push_back(std::move(replaced));
+		dirty = 0;
+		publishes++;
+	}
+	reclaim();
+}
+
+void ForwardingTable::reclaim() {
+	if (retired.empty()) return;
+
+	// the oldest epoch a reader is still in, every view retired before it is unreachable
+	auto oldest = epoch.load(std::memory_order_seq_cst);
+	for (const auto& slot : readers) {
+		auto e = slot.epoch.load(std::memory_order_seq_cst);
+		if (e && e < oldest) oldest = e;
+	}
+
+	auto freed = std::remove_if(retired.begin(), retired.end(), [&](const Retired& r) {
+		if (r.epoch >= oldest) return false;
+		for (auto shard : r.shards) delete shard;
+		delete r.view;
+		return true;
+	});
+	retired.erase(freed, retired.end());
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IGMPForwarding)
@@ -0,0 +1,205 @@
+#ifndef CLICK_IGMPFORWARDING_HH
+#define CLICK_IGMPFORWARDING_HH
+
+#include <click/ipaddress.hh>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+#include "IGMPSlotTable.hh"
+
+CLICK_DECLS
+
+// Set of output ports, one bit per port. The size is fixed so a mask lives inline in its entry and
+// copies and compares without allocating, the router refuses more ports at configure time.
+class PortMask {
+public:
+	static constexpr uint32_t MAX_PORTS = 256;
+
+	void set(uint32_t port) { words[port / 64] |= uint64_t(1) << (port % 64); }
+
+	void reset(uint32_t port) { words[port / 64] &= ~(uint64_t(1) << (port % 64)); }
+
+	bool empty() const {
+		for (auto word : words)
+			if (word) return false;
+		return true;
+	}
+
+	bool operator==(const PortMask& other) const {
+		return std::equal(std::begin(words), std::end(words), std::begin(other.words));
+	}
+
+	// call f(port) for every port in the set, in increasing order
+	template <typename F>
+	void forEach(F&& f) const {
+		for (uint32_t i = 0; i < WORDS; i++) {
+			for (auto bits = words[i]; bits; bits &= bits - 1) {
+				f(uint32_t(i * 64 + __builtin_ctzll(bits)));
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t WORDS = MAX_PORTS / 64;
+
+	uint64_t words[WORDS] = {};
+};
+
+// The interfaces that want the traffic of one group. any holds the interfaces in EXCLUDE mode,
+// a source is only listed when its interfaces differ from any: it's included somewhere or
+// excluded somewhere. The sources are sorted by address.
+struct GroupForwarding {
+	struct Source {
+		uint32_t address;
+		PortMask ports;
+
+		bool operator==(const Source& other) const {
+			return address == other.address && ports == other.ports;
+		}
+	};
+
+	PortMask            any;
+	std::vector<Source> sources;
+
+	bool empty() const { return any.empty() && sources.empty(); }
+
+	bool operator==(const GroupForwarding& other) const {
+		return any == other.any && sources == other.sources;
+	}
+
+	// the interfaces that want traffic from source, most groups have no sources of their own
+	const PortMask& ports(IPAddress source) const {
+		if (sources.empty()) return any;
+		auto iter = std::lower_bound(
+		    sources.begin(), sources.end(), source.addr(),
+		    [](const Source& s, uint32_t address) { return s.address < address; });
+		return iter != sources.end() && iter->address == source.addr() ? iter->ports : any;
+	}
+};
+
+struct ForwardingHash {
+	size_t operator()(uint32_t group) const {
+		// spread the group over all bits, the buckets are picked with a modulo
+		uint64_t key = group;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return size_t(key);
+	}
+};
+
+// group address -> interfaces that want its traffic
+using Forwarding = std::unordered_map<uint32_t, GroupForwarding, ForwardingHash>;
+
+// Published copy of the forwarding entries, split in shards by group. A view never changes once
+// readers can see it. A publish only copies the shards that changed, the others are shared with
+// the view before it.
+struct ForwardingView {
+	static constexpr uint32_t SHARD_BITS = 6;
+	static constexpr uint32_t SHARDS     = 1 << SHARD_BITS;
+
+	static uint32_t shard(IPAddress group) { return fibonacciHash(group.addr(), SHARD_BITS); }
+
+	const Forwarding* shards[SHARDS];
+
+	// get the interfaces that want traffic from source to group, nullptr if there are none
+	// One probe on the group, a group with sources of its own adds a binary search in its entry.
+	const PortMask* ports(IPAddress source, IPAddress group) const {
+		auto& entries = *shards[shard(group)];
+		auto  iter    = entries.find(group.addr());
+		if (iter == entries.end()) return nullptr;
+
+		auto& ports = iter->second.ports(source);
+		return ports.empty() ? nullptr : &ports;
+	}
+};
+
+// Read-copy-update of the forwarding index, with epoch based reclamation.
+//
+// One writer, the router and its timers, changes a private copy of the entries and publishes the
+// shards it changed in a new view, setting an entry to what it already is changes nothing. Any
+// number of readers on other threads look up ports in the current view without taking a lock.
+// A reader announces the epoch it entered in, and a replaced view and its replaced shards are only
+// freed once every reader is either outside a read section or entered after the replacement.
+class ForwardingTable {
+	struct alignas(64) ReaderSlot {
+		std::atomic<uint64_t> epoch{ 0 };    // 0 outside a read section
+	};
+
+public:
+	ForwardingTable();
+	~ForwardingTable();
+
+	ForwardingTable(const ForwardingTable&) = delete;
+	ForwardingTable& operator=(const ForwardingTable&) = delete;
+
+	// writer side, changes are private until the next publish, an empty entry erases the group
+	void set(IPAddress group, GroupForwarding&& entry);
+	void erase(IPAddress group);
+
+	// make the changes visible to the readers and free the views none of them can still see
+	void publish();
+
+	// groups with an entry
+	size_t size() const;
+
+	// views replaced but not freed yet
+	size_t retiredViews() const { return retired.size(); }
+
+	uint64_t publishes = 0;
+
+	// Reserve a slot for one reader. The slots can't move while readers use them, so every reader
+	// has to register before the threads start, in initialize.
+	uint32_t addReader();
+
+	// The current view for as long as the section lives. A reader must not nest sections.
+	class ReadSection {
+	public:
+		ReadSection(const ForwardingTable& table, uint32_t reader) : slot(table.readers[reader]) {
+			// the epoch goes first, the writer sees it before the view can be freed
+			auto epoch = table.epoch.load(std::memory_order_acquire);
+			slot.epoch.store(epoch, std::memory_order_seq_cst);
+			view = table.current.load(std::memory_order_seq_cst);
+		}
+
+		~ReadSection() { slot.epoch.store(0, std::memory_order_release); }
+
+		ReadSection(const ReadSection&) = delete;
+		ReadSection& operator=(const ReadSection&) = delete;
+
+		const ForwardingView* operator->() const { return view; }
+
+	private:
+		ReaderSlot&           slot;
+		const ForwardingView* view;
+	};
+
+private:
+	// a replaced view and the shards only it pointed to
+	struct Retired {
+		const ForwardingView*          view;
+		std::vector<const Forwarding*> shards;
+
+		// readers that entered in this epoch or before may hold them
+		uint64_t epoch;
+	};
+
+	static_assert(ForwardingView::SHARDS == 64, "dirty has one bit per shard");
+
+	Forwarding master[ForwardingView::SHARDS];
+	uint64_t   dirty = 0;    // the shards that changed since the last publish
+
+	std::atomic<const ForwardingView*> current;
+	std::atomic<uint64_t>              epoch{ 1 };
+
+	mutable std::deque<ReaderSlot> readers;
+	std::vector<Retired>           retired;
+
+	void reclaim();
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPFORWARDING_HH
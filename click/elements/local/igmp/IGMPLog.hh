@@ -0,0 +1,76 @@
+#ifndef CLICK_IGMPLOG_HH
+#define CLICK_IGMPLOG_HH
+
+#include <click/element.hh>
+#include <click/error.hh>
+#include <click/string.hh>
+#include <click/confparse.hh>
+
+CLICK_DECLS
+
+// Ordered from least to most verbose, a logger prints everything up to its own level.
+enum class LogLevel : uint8_t { NONE, ERROR, WARNING, INFO, DEBUG };
+
+// Logging state of one IGMP element, settable with the LOGLEVEL keyword and the loglevel handler.
+// Header only: Click only builds translation units that export or provide something.
+struct IGMPLogger {
+	LogLevel level = LogLevel::WARNING;
+
+	inline bool enabled(LogLevel l) const { return l <= level; }
+
+	static const char* name(LogLevel l) {
+		switch (l) {
+		case LogLevel::NONE: return "none";
+		case LogLevel::ERROR: return "error";
+		case LogLevel::WARNING: return "warning";
+		case LogLevel::INFO: return "info";
+		case LogLevel::DEBUG: return "debug";
+		}
+		return "unknown";
+	}
+
+	static bool parse(const String& str, LogLevel& result) {
+		for (auto l : { LogLevel::NONE, LogLevel::ERROR, LogLevel::WARNING, LogLevel::INFO,
+		                LogLevel::DEBUG }) {
+			if (str == name(l)) {
+				result = l;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// parse the optional LOGLEVEL keyword value, an empty string keeps the default
+	int configure(const String& str, ErrorHandler* errh) {
+		if (!str.empty() && !parse(str, level))
+			return errh->error("LOGLEVEL should be none, error, warning, info or debug");
+		return 0;
+	}
+
+	// register the loglevel read and write handler on the owning element
+	void addHandlers(Element* e) {
+		e->add_read_handler("loglevel", &readHandler, this);
+		e->add_write_handler("loglevel", &writeHandler, this);
+	}
+
+	static String readHandler(Element*, void* thunk) {
+		return String(name(((IGMPLogger*) thunk)->level));
+	}
+
+	static int writeHandler(const String& conf, Element*, void* thunk, ErrorHandler* errh) {
+		auto logger = (IGMPLogger*) thunk;
+		if (!parse(cp_uncomment(conf), logger->level))
+			return errh->error("loglevel should be none, error, warning, info or debug");
+		return 0;
+	}
+};
+
+// Only evaluates the format arguments when the level is enabled, so disabled levels cost a compare.
+#define IGMP_LOG(logger, lvl, ...)                                                                 \
+	do {                                                                                           \
+		if (unlikely((logger).enabled(LogLevel::lvl))) click_chatter(__VA_ARGS__);                 \
+	} while (0)
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPLOG_HH
@@ -66,6 +66,18 @@ enum RecordType : uint8_t {
 	source list for the specified multicast address,
 	if it is non-empty */
 	CHANGE_TO_EXCLUDE_MODE = 4,
+
+	/* indicates that the Source Address [i]
+	fields in this Group Record contain a list of the additional
+	sources that the system wishes to hear from, for packets sent to
+	the specified multicast address */
+	ALLOW_NEW_SOURCES = 5,
+
+	/* indicates that the Source Address [i]
+	fields in this Group Record contain a list of the sources that the
+	system no longer wishes to hear from, for packets sent to the
+	specified multicast address */
+	BLOCK_OLD_SOURCES = 6,
 };
 
 enum MessageType : uint8_t { QUERY = 0x11, REPORT = 0x22 };
@@ -113,7 +125,9 @@ struct QueryMessage {
 	the fields described here. */
 
 	inline uint32_t maxRespTime() const { return U8toU32(maxRespCode) * 100; }
-	uint32_t        QQI() const;
+
+	// querier's query interval in seconds, the default when the code is 0
+	inline uint32_t QQI() const;
 };
 
 struct GroupRecord {
@@ -143,6 +157,21 @@ struct GroupRecord {
 	Group Record. The semantics and internal encoding of the Auxiliary
 	Data field are to be defined by any future version or extension of
 	IGMP that uses this field. */
+
+	inline uint16_t sourceCount() const { return ntohs(numSources); }
+
+	inline const in_addr* sources() const { return (const in_addr*) (this + 1); }
+
+	// true if the record lists the source, a linear scan as records hold a handful of sources
+	inline bool lists(IPAddress source) const {
+		for (uint16_t i = 0; i < sourceCount(); i++) {
+			if (sources()[i].s_addr == source.addr()) return true;
+		}
+		return false;
+	}
+
+	// size of the whole record, including the sources and aux data
+	inline size_t size() const { return sizeof(GroupRecord) + (sourceCount() + auxDataLen) * 4u; }
 };
 
 struct ReportMessage {
@@ -166,6 +195,14 @@ const static uint32_t QRV_DEFAULT = 2;
 const static uint32_t QQI_DEFAULT = 125;
 const static uint32_t QRI_DEFAULT = 100;
 
+inline uint32_t QueryMessage::QQI() const { return qqic ? U8toU32(qqic) : QQI_DEFAULT; }
+
+// 224.0.0.1, all systems on this subnet
+const static IPAddress ALL_SYSTEMS = IPAddress(htonl(0xE0000001u));
+
+// 224.0.0.22, all IGMPv3 capable routers, the destination of every report
+const static IPAddress ALL_REPORTS = IPAddress(htonl(0xE0000016u));
+
 QueryMessage createGeneralQuery();
 
 QueryMessage createGroupSpecificQuery(in_addr groupAddress);
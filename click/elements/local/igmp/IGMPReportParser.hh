@@ -0,0 +1,86 @@
+#ifndef CLICK_IGMPREPORTPARSER_HH
+#define CLICK_IGMPREPORTPARSER_HH
+
+#include <click/glue.hh>
+#include <iterator>
+#include "IGMPMessages.hh"
+
+CLICK_DECLS
+
+// Reads the group records of a report straight from the packet buffer, without copying or
+// allocating. The lengths are checked once when the parser is made: every record, with its sources
+// and aux data, has to fit in the message. After that the records can be walked without any checks.
+// Bytes after the last record are ignored, as RFC 3376 asks.
+class ReportParser {
+public:
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = GroupRecord;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const GroupRecord*;
+		using reference         = const GroupRecord&;
+
+		explicit const_iterator(const unsigned char* position) : position(position) {}
+
+		const GroupRecord& operator*() const { return *(const GroupRecord*) position; }
+		const GroupRecord* operator->() const { return (const GroupRecord*) position; }
+
+		const_iterator& operator++() {
+			position += (**this).size();
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			auto old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const const_iterator& other) const { return position == other.position; }
+		bool operator!=(const const_iterator& other) const { return position != other.position; }
+
+	private:
+		const unsigned char* position;
+	};
+
+	// an invalid parser
+	ReportParser() : data(nullptr) {}
+
+	// data points to the report, length is the size of the igmp message from the ip header
+	ReportParser(const void* data, size_t length) : data((const unsigned char*) data) {
+		if (length < sizeof(ReportMessage)) return;
+
+		auto records = ntohs(header()->NumGroupRecords);
+		auto offset  = sizeof(ReportMessage);
+		for (uint32_t i = 0; i < records; i++) {
+			// the fixed part first, the sources and aux data it announces after that
+			if (length - offset < sizeof(GroupRecord)) return;
+			auto record = (const GroupRecord*) (this->data + offset);
+			if (length - offset < record->size()) return;
+			offset += record->size();
+		}
+		end_   = this->data + offset;
+		count_ = records;
+	}
+
+	// false if the report was truncated, nothing else may be used then
+	bool valid() const { return end_ != nullptr; }
+
+	const ReportMessage* header() const { return (const ReportMessage*) data; }
+
+	// number of group records
+	uint16_t size() const { return count_; }
+
+	const_iterator begin() const { return const_iterator(data + sizeof(ReportMessage)); }
+	const_iterator end() const { return const_iterator(end_); }
+
+private:
+	const unsigned char* data;
+	const unsigned char* end_   = nullptr;
+	uint16_t             count_ = 0;
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPREPORTPARSER_HH
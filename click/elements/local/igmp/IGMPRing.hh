@@ -0,0 +1,88 @@
+#ifndef CLICK_IGMPRING_HH
+#define CLICK_IGMPRING_HH
+
+#include <click/glue.hh>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+CLICK_DECLS
+
+// Bounded multiple producer, single consumer queue. Any number of threads push and one thread
+// pops, neither side takes a lock. Every slot carries a sequence number that tells whose turn it
+// is: producers claim a position with a compare and swap on the tail, then publish the value by
+// advancing the sequence of its slot, so the consumer never sees a half written value.
+template <typename T>
+class MpscRing {
+	struct Slot {
+		std::atomic<size_t> sequence{ 0 };
+		T                   value{};
+	};
+
+public:
+	// capacity is rounded up to a power of two, call this before the threads start
+	void reset(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		slots.reset(new Slot[size]);
+		for (size_t i = 0; i < size; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+		mask = size - 1;
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	// producer side, from any thread, false if the queue is full
+	bool push(const T& value) {
+		auto t = tail.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& slot = slots[t & mask];
+			auto  diff = intptr_t(slot.sequence.load(std::memory_order_acquire)) - intptr_t(t);
+			if (diff == 0) {
+				// a failed exchange loads the new tail into t
+				if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+					slot.value = value;
+					slot.sequence.store(t + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				// the slot still holds a value from the previous lap
+				return false;
+			} else {
+				t = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// consumer side, false if the queue is empty, was never reset, or the next value isn't
+	// published yet
+	bool pop(T& value) {
+		if (!slots) return false;
+		auto  h    = head.load(std::memory_order_relaxed);
+		auto& slot = slots[h & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != h + 1) return false;
+
+		value = slot.value;
+		slot.sequence.store(h + mask + 1, std::memory_order_release);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// from any thread, only a snapshot while both sides run
+	size_t size() const {
+		auto h = head.load(std::memory_order_acquire);
+		return tail.load(std::memory_order_acquire) - h;
+	}
+
+	size_t capacity() const { return slots ? mask + 1 : 0; }
+
+private:
+	std::unique_ptr<Slot[]> slots;
+	size_t                  mask = 0;
+
+	alignas(64) std::atomic<size_t> head{ 0 };    // next position to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 };    // next position to claim, shared by the producers
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPRING_HH
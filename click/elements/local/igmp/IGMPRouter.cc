@@ -2,209 +2,1182 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/timer.hh>
+#include <click/task.hh>
+#include <click/straccum.hh>
 #include <clicknet/ether.h>
+#include <algorithm>
 #include "IGMPRouter.hh"
+#include "IGMPChecksum.hh"
 
 CLICK_DECLS
+IGMPRouter::IGMPRouter() : task(this) {}
+
 int IGMPRouter::configure(Vector<String>& conf, ErrorHandler* errh) {
-	if (Args(conf, this, errh)
-	        .read_mp("STATE", ElementCastArg("IGMPRouterState"), state)
-	        .complete()) {
-		return errh->error("Could not parse IGMPRouterState");
+	String            level;
+	String            drop;
+	Vector<IPAddress> addresses;
+	Args              args(conf, this, errh);
+	args.read_mp("STATE", ElementCastArg("IGMPRouterState"), state)
+	    .read_all("ADDRESS", addresses)
+	    .read("ASYNC", async)
+	    .read("QUEUE", queueCapacity)
+	    .read("HOST_QUEUE", hostQueue)
+	    .read("DROP", drop)
+	    .read("EXPLICIT_TRACKING", tracking)
+	    .read("LOGLEVEL", level);
+	if (limitArgs(args, limits).complete()) return errh->error("Could not parse IGMPRouterState");
+	if (logger.configure(level, errh) < 0) return -1;
+
+	if (drop.empty() || drop == "tail") {
+		dropPolicy = DropPolicy::TAIL;
+	} else if (drop == "refresh") {
+		dropPolicy = DropPolicy::REFRESH;
+	} else {
+		return errh->error("DROP should be tail or refresh");
 	}
+	if (async && queueCapacity == 0) return errh->error("QUEUE should be at least 1");
+	if (!hostQueue) hostQueue = std::max(queueCapacity / 16, 1u);
+	if (int(addresses.size()) > ninputs()) return errh->error("more ADDRESS keywords than ports");
+	if (ninputs() > int(PortMask::MAX_PORTS))
+		return errh->error("at most %u ports", PortMask::MAX_PORTS);
+
+	// one slot per port, the groups of a port are found by indexing
+	if (state->interfaces.size() < size_t(ninputs())) state->interfaces.resize(ninputs());
+	buckets.resize(ninputs());
+	applyLimits();
 
-	auto data  = new std::pair<IGMPRouter*, uint32_t>(this, state->startupQueryCount);
-	auto timer = new Timer(IGMPRouter::handleGeneralResend, data);
+	// every port starts out as querier until it hears a router with a lower address
+	for (int i = 0; i < ninputs(); i++) {
+		queriers.emplace_back();
+		auto& querier     = queriers.back();
+		querier.router    = this;
+		querier.interface = uint32_t(i);
+		if (i < int(addresses.size())) querier.address = querier.querier = addresses[i];
+		querier.otherPresent.assign(IGMPRouter::otherQuerierExpire, &querier);
+	}
 
 	// Cool trick with the schedule now to reduce code duplication
-	timer->initialize(this);
-	timer->schedule_now();
+	startupQueries = state->startupQueryCount;
+	generalTimer.assign(IGMPRouter::handleGeneralResend, this);
+	state->wheel.schedule(&generalTimer, 0);
 
 	return 0;
 }
 
-void IGMPRouter::push(int input, Packet* packet) {
-	auto report = (ReportMessage*) (packet->data() + packet->ip_header_length());
+int IGMPRouter::initialize(ErrorHandler*) {
+	if (async) {
+		queue.reset(queueCapacity);
+		hostQueued.assign(1 << HOST_QUEUE_BITS, 0);
+		task.initialize(this, false);
+	}
+	return 0;
+}
 
-	// Idk if this actually doesn't happen, just for safety
-	if (input < 0) return;
+void IGMPRouter::cleanup(CleanupStage) {
+	// the wheel belongs to the state, which can outlive this element
+	if (state) {
+		state->wheel.unschedule(&generalTimer);
+		for (auto& querier : queriers) state->wheel.unschedule(&querier.otherPresent);
+	}
+
+	// reports that were never applied, the queue only exists with ASYNC
+	QueuedReport report;
+	while (async and queue.pop(report)) report.packet->kill();
+}
+
+Args& IGMPRouter::limitArgs(Args& args, Limits& limits) {
+	return args.read("REPORT_RATE", limits.reportRate)
+	    .read("REPORT_BURST", limits.reportBurst)
+	    .read("RECORD_RATE", limits.recordRate)
+	    .read("RECORD_BURST", limits.recordBurst)
+	    .read("HOST_RATE", limits.hostRate)
+	    .read("HOST_BURST", limits.hostBurst)
+	    .read("MAX_GROUPS", limits.maxGroups);
+}
+
+void IGMPRouter::applyLimits() {
+	// a burst of 0 is one second worth of the rate, every bucket starts out full
+	for (auto& bucket : buckets) {
+		bucket.reports.assign(limits.reportRate, burst(limits.reportRate, limits.reportBurst));
+		bucket.reports.set_full();
+		bucket.records.assign(limits.recordRate, burst(limits.recordRate, limits.recordBurst));
+		bucket.records.set_full();
+	}
+	hosts = AddressMap<TokenBucket>();
+}
+
+String IGMPRouter::readLimits(Element* e, void*) {
+	auto&       limits = ((IGMPRouter*) e)->limits;
+	StringAccum sa;
+	sa << "REPORT_RATE " << limits.reportRate << ", REPORT_BURST " << limits.reportBurst
+	   << ", RECORD_RATE " << limits.recordRate << ", RECORD_BURST " << limits.recordBurst
+	   << ", HOST_RATE " << limits.hostRate << ", HOST_BURST " << limits.hostBurst
+	   << ", MAX_GROUPS " << limits.maxGroups;
+	return sa.take_string();
+}
+
+int IGMPRouter::writeLimits(const String& str, Element* e, void*, ErrorHandler* errh) {
+	// the keywords that are left out keep their value
+	auto           router = (IGMPRouter*) e;
+	auto           limits = router->limits;
+	Vector<String> conf;
+	cp_argvec(str, conf);
+
+	Args args(conf, e, errh);
+	if (limitArgs(args, limits).complete() < 0) return -1;
+
+	router->limits = limits;
+	router->applyLimits();
+	return 0;
+}
+
+String IGMPRouter::readHosts(Element* e, void*) {
+	// interface, group, tracked hosts and a ? when there may be more
+	auto        router = (IGMPRouter*) e;
+	StringAccum sa;
+	for (size_t i = 0; i < router->state->interfaces.size(); i++) {
+		for (const auto& group : router->state->interfaces[i]) {
+			sa << i << ' ' << group.address << ' ' << group.hosts.size()
+			   << (group.hostsUncertain ? "?" : "") << '\n';
+		}
+	}
+	return sa.take_string();
+}
+
+String IGMPRouter::readQuerier(Element* e, void*) {
+	// interface, our address, the querier, whether we query and the ms until we take over
+	auto        router = (IGMPRouter*) e;
+	auto&       wheel  = router->state->wheel;
+	StringAccum sa;
+	for (const auto& querier : router->queriers) {
+		sa << querier.interface << ' ' << querier.address << ' ' << querier.querier << ' '
+		   << (querier.querying() ? "querier" : "non-querier") << ' '
+		   << (querier.querying() ? 0 : wheel.remainingMsec(&querier.otherPresent)) << '\n';
+	}
+	return sa.take_string();
+}
+
+String IGMPRouter::readQueue(Element* e, void*) {
+	return String(uint64_t(((IGMPRouter*) e)->queue.size()));
+}
+
+static String readChecksum(Element*, void*) { return String(checksumImplementation()); }
+
+void IGMPRouter::add_handlers() {
+	logger.addHandlers(this);
+	add_read_handler("checksum", &readChecksum, nullptr);
+
+	addCounter(this, "packets_in", stats.packetsIn);
+	addCounter(this, "packets_out", stats.packetsOut);
+	addCounter(this, "drops_no_alert", stats.droppedNoAlert);
+	addCounter(this, "drops_checksum", stats.droppedChecksum);
+	addCounter(this, "drops_type", stats.droppedType);
+	addCounter(this, "drops_truncated", stats.droppedLength);
+	addCounter(this, "reports", stats.reports);
+	addCounter(this, "records", stats.records);
+	addCounter(this, "queries", stats.queries);
+	addCounter(this, "timers_armed", stats.timersArmed);
+	addCounter(this, "groups_created", stats.groupsCreated);
+	addCounter(this, "groups_expired", stats.groupsExpired);
+	addCounter(this, "queued", stats.queued);
+	addCounter(this, "queue_max", stats.queueMax);
+	addCounter(this, "drops_queue_full", stats.droppedQueueFull);
+	addCounter(this, "drops_refresh", stats.droppedRefresh);
+	addCounter(this, "drops_host_queue", stats.droppedHostQueue);
+	add_read_handler("queue", &readQueue, nullptr);
+	addCounter(this, "drops_report_rate", stats.droppedReportRate);
+	addCounter(this, "drops_record_rate", stats.droppedRecordRate);
+	addCounter(this, "drops_host_rate", stats.droppedHostRate);
+	addCounter(this, "drops_max_groups", stats.droppedMaxGroups);
+	addCounter(this, "fast_leaves", stats.fastLeaves);
+	add_read_handler("hosts", &readHosts, nullptr);
+	addCounter(this, "queries_received", stats.queriesReceived);
+	addCounter(this, "querier_changes", stats.querierChanges);
+	add_read_handler("querier", &readQuerier, nullptr);
+	add_read_handler("limits", &readLimits, nullptr);
+	add_write_handler("limits", &writeLimits, nullptr);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+}
+
+const unsigned char* IGMPRouter::checkMessage(Packet* packet, size_t minimum, size_t& length) {
+	auto ip      = (const unsigned char*) packet->ip_header();
+	auto hlen    = packet->ip_header_length();
+	auto total   = size_t(ntohs(packet->ip_header()->ip_len));
+	auto message = ip + hlen;
+	countShared(stats.packetsIn);
+
+	// the igmp message runs from the ip header to the ip length, which has to be in the packet
+	if (total < hlen + minimum || ip + total > packet->end_data()) {
+		countShared(stats.droppedLength);
+		return nullptr;
+	}
+	length = total - hlen;
 
 	// check for alert option
 	RouterAlertOption option{};
-	if (!(packet->ip_header_length() > 5 * 4 &&
-	      !memcmp((packet->data() + packet->ip_header_length() - 4), &option,
-	              sizeof(RouterAlertOption)))) {
+	if (!(hlen > 5 * 4 && !memcmp(message - 4, &option, sizeof(RouterAlertOption)))) {
+		countShared(stats.droppedNoAlert);
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped packet without alert option", this);
+		return nullptr;
+	}
+	// check for bad checksum, it covers the whole message including sources and aux data
+	if (computeChecksum(message, length)) {
+		countShared(stats.droppedChecksum);
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped packet with wrong checksum", this);
+		return nullptr;
+	}
+	return message;
+}
+
+ReportParser IGMPRouter::checkReport(Packet* packet) {
+	size_t length  = 0;
+	auto   message = checkMessage(packet, sizeof(ReportMessage), length);
+	if (!message) return ReportParser();
+
+	// check for report
+	if (message[0] != REPORT) {
+		countShared(stats.droppedType);
+		return ReportParser();
+	}
+
+	// every record has to fit in the message
+	ReportParser parser(message, length);
+	if (!parser.valid()) {
+		countShared(stats.droppedLength);
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped report with truncated records", this);
+	}
+	return parser;
+}
+
+const QueryMessage* IGMPRouter::checkQuery(Packet* packet) {
+	size_t length  = 0;
+	auto   message = checkMessage(packet, sizeof(QueryMessage), length);
+	if (!message) return nullptr;
+
+	// only IGMPv3 queries, the older ones are shorter and were caught by the length
+	if (message[0] != QUERY) {
+		countShared(stats.droppedType);
+		return nullptr;
+	}
+
+	// every source has to fit in the message
+	auto query = (const QueryMessage*) message;
+	if (sizeof(QueryMessage) + ntohs(query->numSources) * sizeof(in_addr) > length) {
+		countShared(stats.droppedLength);
+		IGMP_LOG(logger, DEBUG, "%p{element}: dropped query with truncated sources", this);
+		return nullptr;
+	}
+	return query;
+}
+
+// peek at the igmp type, the checks come after
+static bool isQuery(const Packet* packet) {
+	auto message = (const unsigned char*) packet->ip_header() + packet->ip_header_length();
+	return message < packet->end_data() and message[0] == QUERY;
+}
+
+// EXCLUDE {} in answer to a query, only refreshes the group timer when it's repeated
+static bool isRefresh(const GroupRecord& record) {
+	return record.recordType == RecordType::MODE_IS_EXCLUDE and record.sourceCount() == 0;
+}
+
+// true if the record can add interest in its group, every record except an empty include or
+// allow and a block
+static bool wantsGroup(const GroupRecord& record) {
+	switch (record.recordType) {
+	case RecordType::MODE_IS_EXCLUDE:
+	case RecordType::CHANGE_TO_EXCLUDE_MODE: return true;
+	case RecordType::BLOCK_OLD_SOURCES: return false;
+	default: return record.sourceCount() > 0;
+	}
+}
+
+// the host that sent a report
+static IPAddress sender(const Packet* packet) { return IPAddress(packet->ip_header()->ip_src); }
+
+// TO_IN {}: the host doesn't want the group anymore
+static bool isLeave(const GroupRecord& record) {
+	return record.recordType == RecordType::CHANGE_TO_INCLUDE_MODE and record.sourceCount() == 0;
+}
+
+// only current state records, which hosts send again in answer to every general query
+static bool onlyRefreshes(const ReportParser& parser) {
+	for (auto& record : parser) {
+		if (record.recordType != RecordType::MODE_IS_INCLUDE and
+		    record.recordType != RecordType::MODE_IS_EXCLUDE)
+			return false;
+	}
+	return true;
+}
+
+bool IGMPRouter::admit(uint32_t interface, Packet* packet, const ReportParser& parser) {
+	// Refreshes leave the last quarter of every bucket to the reports that change state, so
+	// leaves and joins still get through while refreshes flood the interface.
+	// A report that asks for more than a bucket holds takes the whole bucket instead, so a big
+	// general response still gets in once the bucket is full.
+	auto refresh = onlyRefreshes(parser);
+	auto reserve = [refresh](uint32_t burst) { return refresh ? burst / 4 : 0; };
+	auto take    = [&](uint32_t burst, uint32_t tokens) {
+		return std::min(tokens, burst - reserve(burst));
+	};
+	auto allows = [&](TokenBucket& bucket, uint32_t burst, uint32_t tokens) {
+		bucket.refill();
+		return bucket.contains(take(burst, tokens) + reserve(burst));
+	};
+	auto drop = [&](uint64_t& counter) {
+		counter++;
+		untrackReport(interface, parser);
+		return false;
+	};
+
+	auto& bucket      = buckets[interface];
+	auto  records     = uint32_t(parser.size());
+	auto  recordBurst = burst(limits.recordRate, limits.recordBurst);
+	if (limits.reportRate and
+	    !allows(bucket.reports, burst(limits.reportRate, limits.reportBurst), 1)) {
+		return drop(stats.droppedReportRate);
+	}
+	if (limits.recordRate and !allows(bucket.records, recordBurst, records)) {
+		return drop(stats.droppedRecordRate);
+	}
+
+	TokenBucket* host = nullptr;
+	auto         from = sender(packet);
+	if (limits.hostRate and from) {
+		// A flood of spoofed sources would grow the table without end, so it starts over when
+		// it's full. The interface buckets still hold then.
+		if (hosts.size() >= MAX_HOSTS) hosts = AddressMap<TokenBucket>();
+
+		auto created = false;
+		host         = &hosts.insert(from, &created);
+		if (created) {
+			host->assign(limits.hostRate, burst(limits.hostRate, limits.hostBurst));
+			host->set_full();
+		}
+		if (!allows(*host, burst(limits.hostRate, limits.hostBurst), 1)) {
+			return drop(stats.droppedHostRate);
+		}
+	}
+
+	// only take the tokens once every bucket agreed
+	if (limits.reportRate) bucket.reports.remove(1);
+	if (limits.recordRate) bucket.records.remove(take(recordBurst, records));
+	if (host) host->remove(1);
+	return true;
+}
+
+uint32_t& IGMPRouter::queuedBy(const Packet* packet) {
+	return hostQueued[fibonacciHash(sender(packet).addr(), HOST_QUEUE_BITS)];
+}
+
+void IGMPRouter::enqueue(uint32_t interface, Packet* packet, const ReportParser& parser,
+                         const QueryMessage* query) {
+	// past 3/4 of the queue the refresh policy keeps the room that is left for state changes
+	auto size = queue.size();
+	if (dropPolicy == DropPolicy::REFRESH and size >= queue.capacity() - queue.capacity() / 4 and
+	    !query and onlyRefreshes(parser)) {
+		countShared(stats.droppedRefresh);
 		packet->kill();
-		click_chatter("Dropped packet without alert option");
 		return;
 	}
-	// check for bad checksum
-	auto length = sizeof(ReportMessage) + ntohs(report->NumGroupRecords) * sizeof(GroupRecord);
-	if (click_in_cksum((const unsigned char*) report, int(length))) {
+
+	// take a slot of the sender's share first, the task gives it back once it popped the report
+	auto& held = queuedBy(packet);
+	if (__atomic_fetch_add(&held, 1, __ATOMIC_RELAXED) >= hostQueue) {
+		__atomic_fetch_sub(&held, 1, __ATOMIC_RELAXED);
+		countShared(stats.droppedHostQueue);
 		packet->kill();
-		click_chatter("Dropped wrong checksum packet in router.");
 		return;
 	}
-	// check for report
-	if (report->type != REPORT) {
+	if (!queue.push({ packet, parser, interface, query })) {
+		__atomic_fetch_sub(&held, 1, __ATOMIC_RELAXED);
+		countShared(stats.droppedQueueFull);
+		IGMP_LOG(logger, WARNING, "%p{element}: report queue full, dropped a report", this);
+		packet->kill();
+		return;
+	}
+
+	countShared(stats.queued);
+
+	// several threads may raise it at once, the largest wins
+	auto max = __atomic_load_n(&stats.queueMax, __ATOMIC_RELAXED);
+	while (size + 1 > max and !__atomic_compare_exchange_n(&stats.queueMax, &max, size + 1, true,
+	                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+	task.reschedule();
+}
+
+bool IGMPRouter::run_task(Task*) {
+	// apply a bounded amount per run so the other tasks of this thread get their turn,
+	// the forwarding view is published once for all of them. Admission happens here rather than
+	// on the receiving threads, so the buckets only ever change on this thread.
+	QueuedReport report;
+	unsigned     applied = 0;
+	while (applied < DRAIN_BURST and queue.pop(report)) {
+		__atomic_fetch_sub(&queuedBy(report.packet), 1, __ATOMIC_RELAXED);
+		if (report.query) {
+			processQuery(report.interface, sender(report.packet), *report.query);
+		} else if (admit(report.interface, report.packet, report.parser)) {
+			applyReport(report.interface, sender(report.packet), report.parser);
+		}
+		report.packet->kill();
+		applied++;
+	}
+	if (!applied) return false;
+
+	state->forwarding.publish();
+	if (queue.size()) task.fast_reschedule();
+	return true;
+}
+
+void IGMPRouter::applyReport(uint32_t interface, IPAddress host, const ReportParser& parser) {
+	auto& groups = interfaceGroups(interface);
+	stats.reports++;
+	for (auto& record : parser) {
+		stats.records++;
+
+		const auto address = IPAddress(record.multicastAddress);
+		if (!validGroup(address)) continue;
+		auto group = findGroup(groups, interface, record);
+		if (group) processRecord(record, *group, host);
+	}
+}
+
+void IGMPRouter::processQuery(uint32_t interface, IPAddress from, const QueryMessage& query) {
+	auto& querier = queriers[interface];
+	stats.queriesReceived++;
+
+	// RFC 3376 6.6.2: the lowest address queries, without an address of our own nothing is lower
+	if (!querier.address or !from or ntohl(from.addr()) >= ntohl(querier.address.addr())) return;
+
+	if (querier.querying() or querier.querier != from) {
+		stats.querierChanges++;
+		IGMP_LOG(logger, INFO, "%p{element}: %s is querier on interface %u", this,
+		         from.unparse().c_str(), interface);
+	}
+	querier.querier = from;
+
+	// RFC 3376 4.1.6 and 4.1.7, the QQI of a query is in seconds. The variables are shared by every
+	// interface, so they follow the last querier heard on any of them.
+	state->adopt(query.resv_s_qrv & 0x07, query.QQI() * 10);
+	state->wheel.schedule(&querier.otherPresent, state->otherQuerierPresentInterval() * 100);
+	stats.timersArmed++;
+
+	// RFC 3376 6.6.1: a group specific query lowers the group timer to LMQT, a group and source
+	// specific one the timers of its sources, unless the S flag says the querier already did
+	if (!query.groupAddress.s_addr or (query.resv_s_qrv & 0x08)) return;
+	auto group = interfaceGroups(interface).find(IPAddress(query.groupAddress));
+	if (!group) return;
+
+	// LMQT from the querier's max response time and the robustness adopted above
+	auto lmqt  = query.maxRespTime() * state->lastMemberQueryCount;
+	auto lower = [&](WheelTimer& timer) {
+		if (!timer.scheduled() or state->wheel.remainingMsec(&timer) <= lmqt) return;
+		state->wheel.schedule(&timer, lmqt);
+		stats.timersArmed++;
+	};
+
+	auto count = ntohs(query.numSources);
+	if (!count) {
+		lower(group->groupTimer);
+		return;
+	}
+	auto sources = (const in_addr*) (&query + 1);
+	for (auto i = 0; i < count; i++) {
+		auto source = group->sources.find(IPAddress(sources[i]));
+		if (source) lower(source->timer);
+	}
+}
+
+void IGMPRouter::push(int input, Packet* packet) {
+	// Idk if this actually doesn't happen, just for safety
+	if (input < 0) {
+		packet->kill();
+		return;
+	}
+
+	// queries from other routers only take part in the election, they change no groups
+	if (isQuery(packet)) {
+		auto query = checkQuery(packet);
+		if (!query) {
+			packet->kill();
+		} else if (async) {
+			enqueue(static_cast<uint32_t>(input), packet, ReportParser(), query);
+		} else {
+			processQuery(static_cast<uint32_t>(input), sender(packet), *query);
+			packet->kill();
+		}
+		return;
+	}
+
+	auto parser = checkReport(packet);
+	if (!parser.valid()) {
 		packet->kill();
 		return;
 	}
 
-	// process and kill packet
-	processReport(report, static_cast<uint32_t>(input));
+	// the task admits and applies it later, on the thread of the router
+	if (async) {
+		enqueue(static_cast<uint32_t>(input), packet, parser);
+		return;
+	}
+	if (!admit(static_cast<uint32_t>(input), packet, parser)) {
+		packet->kill();
+		return;
+	}
+
+	// process and kill packet, one new view for the whole report, the filters pick it up with
+	// their next packet
+	applyReport(static_cast<uint32_t>(input), sender(packet), parser);
+	state->forwarding.publish();
 	packet->kill();
 }
 
-void IGMPRouter::processReport(ReportMessage* report, uint32_t interface) {
-	// create the interface if it doesn't exist
-	if (state->interfaces.find(interface) == state->interfaces.end())
-		state->interfaces.emplace(interface, Groups{});
+#if HAVE_BATCH
+void IGMPRouter::push_batch(int input, PacketBatch* batch) {
+	if (input < 0) {
+		batch->kill();
+		return;
+	}
+	auto interface = static_cast<uint32_t>(input);
+
+	if (async) {
+		FOR_EACH_PACKET_SAFE(batch, packet) {
+			packet->set_next(nullptr);
+			if (isQuery(packet)) {
+				auto query = checkQuery(packet);
+				if (query) {
+					enqueue(interface, packet, ReportParser(), query);
+				} else {
+					packet->kill();
+				}
+				continue;
+			}
+			auto parser = checkReport(packet);
+			if (parser.valid()) {
+				enqueue(interface, packet, parser);
+			} else {
+				packet->kill();
+			}
+		}
+		return;
+	}
+
+	// A batch comes in on one port, so the interface is looked up once. The groups are cached for
+	// the rest of the batch: hosts answering the same query report the same groups back to back.
+	auto& groups = interfaceGroups(interface);
+	batchGroups.clear();
+
+	FOR_EACH_PACKET(batch, packet) {
+		if (isQuery(packet)) {
+			auto query = checkQuery(packet);
+			if (query) processQuery(interface, sender(packet), *query);
+			continue;
+		}
+
+		auto parser = checkReport(packet);
+		if (!parser.valid() or !admit(interface, packet, parser)) continue;
+
+		auto host = sender(packet);
+		stats.reports++;
+		for (auto& record : parser) {
+			stats.records++;
+
+			const auto address = IPAddress(record.multicastAddress);
+			if (!validGroup(address)) continue;
+
+			auto cached = std::find_if(batchGroups.begin(), batchGroups.end(),
+			                           [&](const BatchGroup& g) { return g.address == address; });
+			if (cached == batchGroups.end()) {
+				auto group = findGroup(groups, interface, record);
+				if (!group) continue;
+				if (batchGroups.size() == MAX_BATCH_GROUPS) {
+					processRecord(record, *group, host);
+					continue;
+				}
+				batchGroups.push_back({ address, group, false });
+				cached = batchGroups.end() - 1;
+			}
+
+			// a second refresh in the same batch would only re-arm the timer to the same tick,
+			// the host that sent it still counts
+			auto refresh = isRefresh(record);
+			if (refresh and cached->refreshed) {
+				if (tracking) trackHost(*cached->group, record, host);
+				continue;
+			}
+			cached->refreshed = refresh;
+
+			// a fast leave removes the group, the next record looks it up again
+			if (!processRecord(record, *cached->group, host)) batchGroups.erase(cached);
+		}
+	}
+	state->forwarding.publish();
+	batch->kill();
+}
+#endif
+
+Groups& IGMPRouter::interfaceGroups(uint32_t interface) {
+	// the interfaces are sized for every port in configure
+	return state->interfaces[interface];
+}
+
+bool IGMPRouter::validGroup(IPAddress address) {
+	// check if host asked for a valid multicast address, 224.0.0.1 is an exception
+	return address.is_multicast() and address != ALL_SYSTEMS;
+}
+
+GroupData* IGMPRouter::findGroup(Groups& groups, uint32_t interface, const GroupRecord& record) {
+	const auto address  = IPAddress(record.multicastAddress);
+	auto       existing = groups.find(address);
+	if (existing) return existing;
+
+	// Without state the group is INCLUDE {}: IS_IN {}, TO_IN {} and BLOCK leave it like that, so
+	// a flood of them can't take slots from the joins
+	if (!wantsGroup(record)) return nullptr;
+
+	// a flood of joins can't take more memory and timers than the limit allows
+	if (limits.maxGroups and groups.size() >= limits.maxGroups) {
+		stats.droppedMaxGroups++;
+		IGMP_LOG(logger, DEBUG, "%p{element}: interface %u is at its group limit", this, interface);
+		return nullptr;
+	}
+
+	// create the group
+	auto& group = groups.insert(address);
+
+	group.router    = this;
+	group.interface = interface;
+	group.address   = address;
+	group.groupTimer.assign(IGMPRouter::groupExpire, &group);
+
+	// start the timer with this expiry time to delete the group
+	state->wheel.schedule(&group.groupTimer, state->groupMembershipInterval * 100);
+	stats.timersArmed++;
+	stats.groupsCreated++;
+	return &group;
+}
+
+SourceData& IGMPRouter::findSource(GroupData& group, IPAddress address) {
+	// create the source if it doesn't exist, its timer isn't running yet
+	auto  created = false;
+	auto& source  = group.sources.insert(address, &created);
+	if (!created) return source;
+
+	source.group   = &group;
+	source.address = address;
+	source.timer.assign(IGMPRouter::sourceExpire, &source);
+	return source;
+}
+
+void IGMPRouter::armSource(SourceData& source, uint32_t msec) {
+	// a source timer of 0 means excluded, which is a stopped timer
+	if (msec == 0) {
+		state->wheel.unschedule(&source.timer);
+		return;
+	}
+	state->wheel.schedule(&source.timer, msec);
+	stats.timersArmed++;
+}
+
+void IGMPRouter::removeUnlisted(GroupData& group, const GroupRecord& record) {
+	std::vector<IPAddress> unlisted;
+	for (const auto& source : group.sources) {
+		if (!record.lists(source.address)) unlisted.push_back(source.address);
+	}
+	for (auto source : unlisted) state->removeSource(group, source);
+}
+
+void IGMPRouter::queryGroup(GroupData& group) {
+	// this is only triggered when the router doesn't know if someone is listening
+	// and hasn't yet started the procedure to remedy this.
+
+	// a non-querier leaves it to the querier, whose queries lower the timers in processQuery
+	if (!querying(group.interface)) return;
+
+	// (re)start the procedure, this replaces a send timer that is already running
+	auto& queries      = startQueries(group);
+	queries.numResends = state->lastMemberQueryCount;
+	queries.first      = true;
+
+	// this useful comment tells you the next line start a timer that sends a group specific
+	// query
+	state->wheel.schedule(&queries.sendTimer, 0);
+	stats.timersArmed++;
+}
+
+GroupQueries& IGMPRouter::startQueries(GroupData& group) {
+	if (!group.queries) {
+		group.queries.reset(new GroupQueries);
+		group.queries->sendTimer.assign(IGMPRouter::handleSpecificResend, &group);
+		group.queries->sourceQueryTimer.assign(IGMPRouter::handleSourceResend, &group);
+	}
+	return *group.queries;
+}
+
+void IGMPRouter::endQueries(GroupData& group) {
+	// the timer that called this is unlinked already, the wheel doesn't touch it anymore
+	if (group.queries and group.queries->idle()) group.queries.reset();
+}
 
-	for (auto i = 0; i < ntohs(report->NumGroupRecords); i++) {
-		GroupRecord* record  = ((GroupRecord*) (report + 1)) + i;
-		const auto   address = IPAddress(record->multicastAddress);
+void IGMPRouter::querySources(GroupData& group, const std::vector<IPAddress>& sources) {
+	// as in queryGroup, the querier's queries do this on a non-querier
+	if (!querying(group.interface)) return;
 
-		// check if host asked for a valid multicast address, 224.0.0.1 is an exception
-		if (!address.is_multicast() or address == IPAddress("224.0.0.1")) continue;
+	// the sources get LMQT to answer, a report for them arms their timer again
+	auto lmqt = state->lastMemberQueryTime * 100;
+	for (auto address : sources) {
+		auto source = group.sources.find(address);
+		if (!source) continue;
+
+		if (state->wheel.remainingMsec(&source->timer) > lmqt) armSource(*source, lmqt);
+		auto& pending = startQueries(group).querySources;
+		if (std::find(pending.begin(), pending.end(), address) == pending.end())
+			pending.push_back(address);
+	}
+	if (!group.queries or group.queries->querySources.empty()) return;
+
+	group.queries->sourceResends = state->lastMemberQueryCount;
+	state->wheel.schedule(&group.queries->sourceQueryTimer, 0);
+	stats.timersArmed++;
+}
 
-		// create the group if it doesn't exist
-		if (state->interfaces[interface].find(address) == state->interfaces[interface].end()) {
-			auto data  = new std::pair<Groups*, IPAddress>(&state->interfaces[interface], address);
-			auto timer = new Timer(IGMPRouter::groupExpire, data);
+// RFC 3376 6.4, the comments give the new state and the actions of every case. B is the source
+// list of the record. In INCLUDE mode the group's sources are A, in EXCLUDE mode they are X
+// (requested, timer running) and Y (excluded, timer stopped), and A is the record's list.
+bool IGMPRouter::processRecord(const GroupRecord& record, GroupData& group, IPAddress host) {
+	const auto gmi     = state->groupMembershipInterval * 100;
+	const auto count   = record.sourceCount();
+	const auto sources = record.sources();
+	const auto type    = record.recordType;
 
-			// start the timer with this expiry time to delete the group
-			timer->initialize(this);
-			timer->schedule_after_msec(state->groupMembershipInterval * 100);
+	// 0.0.0.0 can't be a source, a record that lists it is malformed
+	for (auto i = 0; i < count; i++) {
+		if (!sources[i].s_addr) return true;
+	}
 
-			state->interfaces[interface].emplace(address, GroupData{ timer, nullptr, false });
+	// Fast leave: the last host that wanted the group left, so nobody has to be asked. When the
+	// hosts aren't known for sure the last member queries below find out as usual.
+	if (tracking) {
+		trackHost(group, record, host);
+		if (isLeave(record) and group.hosts.empty() and !group.hostsUncertain) {
+			IGMP_LOG(logger, INFO, "%p{element}: last host left group %s", this,
+			         group.address.unparse().c_str());
+			state->removeGroup(group.interface, group.address);
+			stats.fastLeaves++;
+			return false;
 		}
+	}
+
+	// without sources the forwarding only depends on the filter mode
+	const auto wasExclude = group.isExclude;
+	const auto hadSources = !group.sources.empty();
+
+	// sources for a group and source specific query
+	std::vector<IPAddress> query;
 
-		auto& group = state->interfaces[interface][address];
+	if (!group.isExclude) {
+		switch (type) {
+		case RecordType::MODE_IS_INCLUDE:
+		case RecordType::ALLOW_NEW_SOURCES:
+			// INCLUDE (A+B), (B) = GMI
+			for (auto i = 0; i < count; i++) armSource(findSource(group, sources[i]), gmi);
+			break;
 
-		if (record->recordType == RecordType::MODE_IS_EXCLUDE or
-		    record->recordType == RecordType::CHANGE_TO_EXCLUDE_MODE) {
-			// Exclude {} -> Someone wants to listen so we set it to true
+		case RecordType::CHANGE_TO_INCLUDE_MODE:
+			// INCLUDE (A+B), (B) = GMI, Send Q(G, A-B)
+			for (const auto& source : group.sources) {
+				if (!record.lists(source.address)) query.push_back(source.address);
+			}
+			for (auto i = 0; i < count; i++) armSource(findSource(group, sources[i]), gmi);
+			break;
+
+		case RecordType::BLOCK_OLD_SOURCES:
+			// INCLUDE (A), Send Q(G, A*B)
+			for (auto i = 0; i < count; i++) {
+				if (group.sources.find(sources[i])) query.push_back(sources[i]);
+			}
+			break;
+
+		case RecordType::MODE_IS_EXCLUDE:
+		case RecordType::CHANGE_TO_EXCLUDE_MODE:
+			// EXCLUDE (A*B, B-A), (B-A) = 0, Delete (A-B), GT = GMI
+			// TO_EX also sends Q(G, A*B)
+			for (auto i = 0; i < count; i++) {
+				if (type == RecordType::CHANGE_TO_EXCLUDE_MODE and group.sources.find(sources[i]))
+					query.push_back(sources[i]);
+			}
+			removeUnlisted(group, record);
+			for (auto i = 0; i < count; i++) findSource(group, sources[i]);
+
+			// Exclude -> Someone wants to listen so we set it to true
 			group.isExclude = true;
 
 			// Reset the group timer to the expiry as we know at least someone is listening
-			group.groupTimer->schedule_after_msec(state->groupMembershipInterval * 100);
+			state->wheel.schedule(&group.groupTimer, gmi);
+			stats.timersArmed++;
+			break;
 
-		} else if (group.isExclude) {
-			// this is only triggered when the router doesn't know if someone is listening
-			// and hasn't yet started the procedure to remedy this.
+		default: return true;
+		}
+	} else {
+		switch (type) {
+		case RecordType::MODE_IS_INCLUDE:
+		case RecordType::ALLOW_NEW_SOURCES:
+			// EXCLUDE (X+A, Y-A), (A) = GMI
+			for (auto i = 0; i < count; i++) armSource(findSource(group, sources[i]), gmi);
+			break;
+
+		case RecordType::CHANGE_TO_INCLUDE_MODE:
+			// EXCLUDE (X+A, Y-A), (A) = GMI, Send Q(G, X-A), Send Q(G)
+			for (const auto& source : group.sources) {
+				if (source.timer.scheduled() and !record.lists(source.address))
+					query.push_back(source.address);
+			}
+			for (auto i = 0; i < count; i++) armSource(findSource(group, sources[i]), gmi);
+			queryGroup(group);
+			break;
+
+		case RecordType::BLOCK_OLD_SOURCES: {
+			// EXCLUDE (X+(A-Y), Y), (A-X-Y) = GT, Send Q(G, A-Y)
+			auto timer = state->wheel.remainingMsec(&group.groupTimer);
+			for (auto i = 0; i < count; i++) {
+				auto source = group.sources.find(sources[i]);
+				if (!source) {
+					armSource(findSource(group, sources[i]), timer);
+				} else if (!source->timer.scheduled()) {
+					continue;
+				}
+				query.push_back(sources[i]);
+			}
+			break;
+		}
+
+		case RecordType::MODE_IS_EXCLUDE:
+		case RecordType::CHANGE_TO_EXCLUDE_MODE: {
+			// EXCLUDE (A-Y, Y*A), Delete (X-A), Delete (Y-A), GT = GMI
+			// IS_EX: (A-X-Y) = GMI
+			// TO_EX: (A-X-Y) = GT, Send Q(G, A-Y)
+			auto toExclude = type == RecordType::CHANGE_TO_EXCLUDE_MODE;
+			auto timer     = toExclude ? state->wheel.remainingMsec(&group.groupTimer) : gmi;
+			removeUnlisted(group, record);
+			for (auto i = 0; i < count; i++) {
+				auto source = group.sources.find(sources[i]);
+				if (!source) {
+					armSource(findSource(group, sources[i]), timer);
+				} else if (!source->timer.scheduled()) {
+					continue;
+				}
+				if (toExclude) query.push_back(sources[i]);
+			}
+
+			// Reset the group timer to the expiry as we know at least someone is listening
+			state->wheel.schedule(&group.groupTimer, gmi);
+			stats.timersArmed++;
+			break;
+		}
 
-			// delete the old send timer
-			if (group.sendTimer) group.sendTimer->clear();
+		default: return true;
+		}
+	}
+
+	if (!query.empty()) querySources(group, query);
+	if (wasExclude == group.isExclude and !hadSources and group.sources.empty()) return true;
+	state->refresh(group.address);
+	return true;
+}
 
-			// create the timer state
-			auto data =
-				new TimerData{ this, interface, address, state->lastMemberQueryCount, true };
+void IGMPRouter::untrackReport(uint32_t interface, const ReportParser& parser) {
+	// The sender may want these groups without the router knowing, so an empty host set no longer
+	// proves nobody listens. The groups it would have created don't exist, there's nothing to mark.
+	if (!tracking) return;
+	auto& groups = interfaceGroups(interface);
+	for (auto& record : parser) {
+		auto group = groups.find(IPAddress(record.multicastAddress));
+		if (group) group->hostsUncertain = true;
+	}
+}
 
-			// this useful comment tells you the next line start a timer that sends a group specific
-			// query
-			auto timer = new Timer(IGMPRouter::handleSpecificResend, data);
+void IGMPRouter::trackHost(GroupData& group, const GroupRecord& record, IPAddress host) {
+	// reports from 0.0.0.0 can't be told apart, neither can hosts past the limit
+	if (!host or (group.hosts.size() >= MAX_TRACKED_HOSTS and !group.hosts.contains(host))) {
+		group.hostsUncertain = true;
+		return;
+	}
 
-			// initialize and assign timer
-			timer->initialize(this);
-			timer->schedule_now();
-			group.sendTimer = timer;
+	switch (record.recordType) {
+	case RecordType::MODE_IS_INCLUDE:
+	case RecordType::CHANGE_TO_INCLUDE_MODE:
+		// INCLUDE {} is a host without interest in the group
+		if (record.sourceCount() == 0) {
+			group.hosts.erase(host);
+		} else {
+			group.hosts.insert(host);
 		}
-		// If the mode is already include we don't have to worry about anything :)
+		break;
+
+	case RecordType::MODE_IS_EXCLUDE:
+	case RecordType::CHANGE_TO_EXCLUDE_MODE:
+	case RecordType::ALLOW_NEW_SOURCES: group.hosts.insert(host); break;
+
+	// blocking sources says nothing about the others the host may still want
+	default: break;
 	}
 }
 
-void IGMPRouter::groupExpire(Timer* timer, void* data) {
-	auto* state = (std::pair<Groups*, IPAddress>*) data;
+void IGMPRouter::groupExpire(WheelTimer*, void* data) {
+	auto group = (GroupData*) data;
+	auto self  = group->router;
+	auto state = self->state;
+
+	if (group->isExclude) {
+		// RFC 3376 6.5: the requested sources keep the group alive in INCLUDE mode
+		std::vector<IPAddress> excluded;
+		auto                   requested = false;
+		for (const auto& source : group->sources) {
+			if (source.timer.scheduled()) {
+				requested = true;
+			} else {
+				excluded.push_back(source.address);
+			}
+		}
+
+		if (requested) {
+			for (auto source : excluded) state->removeSource(*group, source);
+			group->isExclude = false;
+			state->refresh(group->address);
+			state->forwarding.publish();
+			IGMP_LOG(self->logger, INFO, "%p{element}: group %s switched to include mode", self,
+			         group->address.unparse().c_str());
+			return;
+		}
+		IGMP_LOG(self->logger, INFO, "%p{element}: removed group %s", self,
+		         group->address.unparse().c_str());
 
-	// for safety
-	if ((*state->first)[state->second].isExclude) {
-		click_chatter("removed group %s", state->second.unparse().c_str());
-		(*state->first)[state->second].isExclude = false;
+	} else if (!group->sources.empty()) {
+		// in INCLUDE mode the group lives as long as one of its sources
+		return;
 	}
 
-	// remove the group record
-	state->first->erase(state->second);
+	// remove the group record and stop forwarding it, this also frees the group's timers
+	state->removeGroup(group->interface, group->address);
+	state->forwarding.publish();
+	self->stats.groupsExpired++;
 }
 
-void IGMPRouter::handleSpecificResend(Timer* timer, void* data) {
-	auto values = (TimerData*) (data);
+void IGMPRouter::sourceExpire(WheelTimer*, void* data) {
+	auto source = (SourceData*) data;
+	auto group  = source->group;
+	auto self   = group->router;
+	auto state  = self->state;
+
+	// in EXCLUDE mode the source stays as an excluded one, which is a stopped timer
+	if (group->isExclude) {
+		state->refresh(group->address);
+		state->forwarding.publish();
+		return;
+	}
 
-	values->numResends--;
-	if (values->numResends == 0) return;
+	// in INCLUDE mode it's deleted, and the group with it when it was the last one
+	state->removeSource(*group, source->address);
+	if (group->sources.empty()) {
+		state->removeGroup(group->interface, group->address);
+		state->forwarding.publish();
+		self->stats.groupsExpired++;
+		return;
+	}
+	state->refresh(group->address);
+	state->forwarding.publish();
+}
 
-	sendGroupSpecificQuery(values->self, values->interface, values->address);
-	timer->schedule_after_msec(values->self->state->lastMemberQueryInterval * 100);
+void IGMPRouter::handleSpecificResend(WheelTimer* timer, void* data) {
+	auto  group   = (GroupData*) data;
+	auto  self    = group->router;
+	auto  state   = self->state;
+	auto& queries = *group->queries;
 
-	if (values->first) {
-		// change group timer value
-		auto state = values->self->state;
+	queries.numResends--;
+	if (queries.numResends == 0) {
+		endQueries(*group);
+		return;
+	}
 
-		if (state->interfaces.find(values->interface) == state->interfaces.end()) return;
-		const auto network = state->interfaces[values->interface];
-		if (network.find(values->address) == network.end()) return;
-		auto group = network.find(values->address)->second;
+	sendGroupSpecificQuery(self, *group);
+	state->wheel.schedule(timer, state->lastMemberQueryInterval * 100);
+	self->stats.timersArmed++;
 
+	if (queries.first) {
 		// reschedule group timer to LMQT
-		group.groupTimer->schedule_after_msec(state->lastMemberQueryTime * 100);
-		values->first = false;
+		state->wheel.schedule(&group->groupTimer, state->lastMemberQueryTime * 100);
+		self->stats.timersArmed++;
+		queries.first = false;
 	}
 }
 
-void IGMPRouter::handleGeneralResend(Timer* timer, void* data) {
-	auto* state = (std::pair<IGMPRouter*, uint32_t>*) (data);
-	sendGeneralQueries(state->first);
+void IGMPRouter::handleSourceResend(WheelTimer* timer, void* data) {
+	auto  group   = (GroupData*) data;
+	auto  self    = group->router;
+	auto  state   = self->state;
+	auto& queries = *group->queries;
+
+	// a source that was reported again since has its timer above LMQT and is asked for no more
+	auto lmqt    = state->lastMemberQueryTime * 100;
+	auto pending = std::remove_if(
+	    queries.querySources.begin(), queries.querySources.end(), [&](IPAddress address) {
+		    auto source = group->sources.find(address);
+		    return !source || !source->timer.scheduled() ||
+		           state->wheel.remainingMsec(&source->timer) > lmqt;
+	    });
+	queries.querySources.erase(pending, queries.querySources.end());
 
-	if (state->second > 0) {
-		state->second--;
-		timer->schedule_after_msec(state->first->state->startupQueryInterval * 100);
+	if (queries.querySources.empty() || queries.sourceResends == 0) {
+		queries.querySources.clear();
+		endQueries(*group);
+		return;
+	}
+
+	sendSourceSpecificQuery(self, *group);
+	if (--queries.sourceResends > 0) {
+		state->wheel.schedule(timer, state->lastMemberQueryInterval * 100);
+		self->stats.timersArmed++;
 	} else {
-		timer->schedule_after_msec(state->first->state->queryInterval * 100);
+		queries.querySources.clear();
+		endQueries(*group);
 	}
 }
 
-void IGMPRouter::sendGroupSpecificQuery(IGMPRouter* self, uint32_t interface, IPAddress address) {
-	if (self->state->interfaces.find(interface) == self->state->interfaces.end()) return;
-	const auto network = self->state->interfaces[interface];
+void IGMPRouter::otherQuerierExpire(WheelTimer*, void* data) {
+	auto querier = (Querier*) data;
+	auto self    = querier->router;
+
+	// RFC 3376 6.6.2: the other querier went quiet, take over with a general query of our own
+	querier->querier = querier->address;
+	self->stats.querierChanges++;
+	IGMP_LOG(self->logger, INFO, "%p{element}: querier on interface %u again", self,
+	         querier->interface);
+	self->sendGeneralQuery(querier->interface);
+}
+
+void IGMPRouter::handleGeneralResend(WheelTimer* timer, void* data) {
+	auto self = (IGMPRouter*) data;
+	sendGeneralQueries(self);
+
+	if (self->startupQueries > 0) {
+		self->startupQueries--;
+		self->state->wheel.schedule(timer, self->state->startupQueryInterval * 100);
+	} else {
+		self->state->wheel.schedule(timer, self->state->queryInterval * 100);
+	}
+}
 
-	if (network.find(address) == network.end()) return;
+const IGMPRouter::QueryCache& IGMPRouter::queryCache() {
+	if (queries.valid && queries.version == state->version) return queries;
 
-	auto duration =
-		network.find(address)->second.groupTimer->expiry_steady() - Timestamp::now_steady();
-	auto s = duration > Timestamp::make_msec(self->state->lastMemberQueryTime * 100);
-	//	click_chatter("%s, %u", duration.unparse().c_str(), s);
+	uint8_t byte    = std::min(state->robustness, 7u);
+	queries.general = QueryMessage{ MessageType::QUERY,
+		                            U32toU8(state->queryResponseInterval),
+		                            0,
+		                            0,
+		                            byte,
+		                            U32toU8(state->queryInterval / 10),
+		                            0 };
+	queries.general.checksum = computeChecksum(&queries.general, sizeof(QueryMessage));
 
-	uint8_t byte = (s << 3) + std::min(self->state->robustness, 7u);
-	auto    msg  = QueryMessage{ MessageType::QUERY,
-                             U32toU8(self->state->lastMemberQueryInterval),
-                             0,
-                             address,
-                             byte,
-                             U32toU8(self->state->queryInterval),
-                             0 };
+	// the group and the S flag are filled in per send
+	queries.specific             = queries.general;
+	queries.specific.maxRespCode = U32toU8(state->lastMemberQueryInterval);
+	queries.specific.checksum    = 0;
+	queries.specific.checksum    = computeChecksum(&queries.specific, sizeof(QueryMessage));
 
-	msg.checksum = click_in_cksum((const unsigned char*) (&msg), sizeof(QueryMessage));
-	auto packet  = Packet::make(sizeof(click_ether) + sizeof(click_ip), &msg, sizeof(msg), 0);
-	click_chatter("sending group specific query");
+	queries.valid   = true;
+	queries.version = state->version;
+	IGMP_LOG(logger, DEBUG, "%p{element}: rebuilt query templates", this);
+	return queries;
+}
 
-	self->output(int(interface)).push(packet);
+Packet* IGMPRouter::makeQuery(const QueryMessage& msg) {
+	auto packet = Packet::make(sizeof(click_ether) + sizeof(click_ip) + sizeof(RouterAlertOption),
+	                           &msg, sizeof(msg), 0);
+	if (!packet) IGMP_LOG(logger, ERROR, "%p{element}: could not allocate query", this);
+	return packet;
 }
 
-void IGMPRouter::sendGeneralQueries(IGMPRouter* self) {
-	uint8_t byte = std::min(self->state->robustness, 7u);
-	auto    msg  = QueryMessage{ MessageType::QUERY,
-                             U32toU8(self->state->queryResponseInterval),
-                             0,
-                             0,
-                             byte,
-                             U32toU8(self->state->queryInterval),
-                             0 };
+void IGMPRouter::sendGroupSpecificQuery(IGMPRouter* self, const GroupData& group) {
+	// a non-querier keeps its timers but stays silent, also when it lost the election halfway
+	if (!self->querying(group.interface)) return;
 
-	msg.checksum = click_in_cksum((const unsigned char*) (&msg), sizeof(QueryMessage));
-	auto packet  = Packet::make(sizeof(click_ether) + sizeof(click_ip), &msg, sizeof(msg), 0);
+	auto duration = self->state->wheel.remainingMsec(&group.groupTimer);
+	auto s        = duration > self->state->lastMemberQueryTime * 100;
 
-	for (int i = 0; i < self->noutputs(); i++) { self->output(i).push(packet->clone()); }
+	auto packet = self->makeQuery(self->queryCache().specific);
+	if (!packet) return;
+
+	// patch the template in the new packet, the checksum follows the changed words
+	auto     msg   = (QueryMessage*) packet->data();
+	auto     flags = (uint16_t*) &msg->resv_s_qrv;
+	uint16_t old   = *flags;
+
+	msg->groupAddress = group.address.in_addr();
+	msg->resv_s_qrv |= s << 3;
+	msg->checksum = updateChecksum32(msg->checksum, 0, msg->groupAddress.s_addr);
+	msg->checksum = updateChecksum16(msg->checksum, old, *flags);
+
+	IGMP_LOG(self->logger, DEBUG, "%p{element}: sending group specific query", self);
+	self->stats.queries++;
+	self->stats.packetsOut++;
+	self->output(int(group.interface)).push(packet);
+}
+
+void IGMPRouter::sendSourceSpecificQuery(IGMPRouter* self, const GroupData& group) {
+	if (!self->querying(group.interface)) return;
+
+	// one query lists all pending sources, as many as fit in an unfragmented packet
+	auto& querySources = group.queries->querySources;
+	auto  count        = std::min(querySources.size(), MAX_QUERY_SOURCES);
+	auto  size         = sizeof(QueryMessage) + count * sizeof(in_addr);
+
+	auto packet = Packet::make(sizeof(click_ether) + sizeof(click_ip) + sizeof(RouterAlertOption),
+	                           nullptr, size, 0);
+	if (!packet) {
+		IGMP_LOG(self->logger, ERROR, "%p{element}: could not allocate query", self);
+		return;
+	}
+
+	// patch the group and the number of sources into the template, then add the sources
+	auto msg     = (QueryMessage*) packet->data();
+	*msg         = self->queryCache().specific;
+	auto sources = (in_addr*) (msg + 1);
+	for (size_t i = 0; i < count; i++) sources[i] = querySources[i].in_addr();
+
+	msg->groupAddress = group.address.in_addr();
+	msg->numSources   = htons(uint16_t(count));
+	msg->checksum     = updateChecksum32(msg->checksum, 0, msg->groupAddress.s_addr);
+	msg->checksum     = updateChecksum16(msg->checksum, 0, msg->numSources);
+	msg->checksum     = insertChecksum(msg->checksum, sources, count * sizeof(in_addr));
+
+	IGMP_LOG(self->logger, DEBUG, "%p{element}: sending group and source specific query", self);
+	self->stats.queries++;
+	self->stats.packetsOut++;
+	self->output(int(group.interface)).push(packet);
+}
+
+void IGMPRouter::sendGeneralQuery(uint32_t interface) {
+	auto packet = makeQuery(queryCache().general);
+	if (!packet) return;
+
+	stats.queries++;
+	stats.packetsOut++;
+	output(int(interface)).push(packet);
+}
+
+void IGMPRouter::sendGeneralQueries(IGMPRouter* self) {
+	// Every interface gets a packet of its own rather than a clone: the encapsulation downstream
+	// writes in front of it, which would force a copy of a shared packet anyway.
+	// Interfaces where another router is querier are skipped.
+	for (int i = 0; i < self->noutputs(); i++) {
+		if (self->querying(uint32_t(i))) self->sendGeneralQuery(uint32_t(i));
+	}
 }
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(IGMPRouter)
+ELEMENT_REQUIRES(IGMPChecksum)
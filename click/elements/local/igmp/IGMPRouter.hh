@@ -2,24 +2,38 @@
 #define IGMPROUTER_HH
 
 #include <click/element.hh>
+#include <click/args.hh>
+#include <click/task.hh>
+#include <click/tokenbucket.hh>
 #include "IGMPRouterState.hh"
 #include "IGMPMessages.hh"
-
-// terminated group membership report -> query network before deleting group
-
-class IGMPRouter;
-
-struct TimerData {
-	IGMPRouter* self;
-	uint32_t    interface;
-	IPAddress   address;
-	uint32_t    numResends;
-	bool first;
-};
+#include "IGMPReportParser.hh"
+#include "IGMPBatch.hh"
+#include "IGMPRing.hh"
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
+#include <deque>
+#include <vector>
 
 CLICK_DECLS
-class IGMPRouter: public Element {
+// With ASYNC true the threads that push reports into any of the inputs only check them and queue
+// them, a task admits them by the limits and applies them to the state. Without it every input
+// has to be pushed from the router's home thread. The task runs on the router's home thread, which
+// has to be the home thread of the state as well because the state's timers run there: put both
+// on the same thread with StaticThreadSched. QUEUE sets the capacity, DROP what happens when it
+// runs full: tail drops every new report, refresh already drops answers to queries at 3/4 full so
+// the rest of the queue stays free for state changes. HOST_QUEUE caps the reports one sending
+// host can have in the queue at once, a sixteenth of QUEUE by default, so a single flooding host
+// can't fill it before the limits get to see its reports.
+//
+// ADDRESS gives the address of the router on a port, once per port in port order. Of the routers
+// on a network the one with the lowest address queries it, the others stay silent as long as they
+// hear its queries and take over its robustness and query interval. A port without an address
+// always queries.
+class IGMPRouter: public IGMPBatchElement {
 public:
+	IGMPRouter();
+
 	const char* class_name() const override { return "IGMPRouter"; }
 
 	const char* port_count() const override { return "-/="; }
@@ -28,22 +42,282 @@ public:
 
 	int configure(Vector<String>&, ErrorHandler*) override;
 
+	int initialize(ErrorHandler*) override;
+
+	void add_handlers() override;
+
+	void cleanup(CleanupStage) override;
+
 	void push(int, Packet*) override;
+#if HAVE_BATCH
+	void push_batch(int, PacketBatch*) override;
+#endif
+
+	bool run_task(Task*) override;
 
-	void processReport(ReportMessage* report, uint32_t interface);
+	static void groupExpire(WheelTimer*, void*);
 
-	static void groupExpire(Timer*, void*);
+	static void sourceExpire(WheelTimer*, void*);
 
-	static void handleSpecificResend(Timer*, void*);
+	// terminated group membership report -> query network before deleting group
+	static void handleSpecificResend(WheelTimer*, void*);
 
-	static void handleGeneralResend(Timer*, void*);
+	// blocked sources -> query network before they stop being forwarded
+	static void handleSourceResend(WheelTimer*, void*);
 
-	static void sendGroupSpecificQuery(IGMPRouter* self, uint32_t interface, IPAddress address);
+	static void handleGeneralResend(WheelTimer*, void*);
+
+	// no query from the other querier for the other querier present interval -> query ourselves
+	static void otherQuerierExpire(WheelTimer*, void*);
+
+	static void sendGroupSpecificQuery(IGMPRouter* self, const GroupData& group);
+
+	static void sendSourceSpecificQuery(IGMPRouter* self, const GroupData& group);
 
 	static void sendGeneralQueries(IGMPRouter* self);
 
 private:
-	IGMPRouterState* state;
+	// the igmp message in the packet if it has the alert option, a good checksum and at least
+	// minimum bytes, nullptr after counting the drop otherwise. length is set to its length.
+	const unsigned char* checkMessage(Packet* packet, size_t minimum, size_t& length);
+
+	// the records of the report in the packet if it passes every check, an invalid parser after
+	// counting the drop otherwise
+	ReportParser checkReport(Packet* packet);
+
+	// the query in the packet if it passes every check, nullptr after counting the drop otherwise
+	const QueryMessage* checkQuery(Packet* packet);
+
+	// Querier election on every port, RFC 3376 6.6.2
+	struct Querier {
+		IGMPRouter* router    = nullptr;
+		uint32_t    interface = 0;
+		IPAddress   address;    // ours on the port, 0.0.0.0 takes no part in the election
+		IPAddress   querier;    // the router that queries the port, ours while we do
+
+		// runs while another router is querier
+		WheelTimer otherPresent;
+
+		bool querying() const { return !otherPresent.scheduled(); }
+	};
+	std::deque<Querier> queriers;    // indexed by port, a deque because the timers can't move
+
+	bool querying(uint32_t interface) const { return queriers[interface].querying(); }
+
+	// Apply a valid query from another router that came in on the interface: the election, and
+	// the timers a query of the querier lowers, RFC 3376 6.6.1
+	void processQuery(uint32_t interface, IPAddress from, const QueryMessage& query);
+
+	void sendGeneralQuery(uint32_t interface);
+
+	static String readQuerier(Element* e, void* thunk);
+
+	Groups& interfaceGroups(uint32_t interface);
+
+	static bool validGroup(IPAddress address);
+
+	// Admission of reports per interface and per sending host, with token buckets. A rate of 0
+	// doesn't limit, a burst of 0 is one second of the rate.
+	struct Limits {
+		uint32_t reportRate  = 0;    // reports per second per interface
+		uint32_t reportBurst = 0;
+		uint32_t recordRate  = 0;    // group records per second per interface
+		uint32_t recordBurst = 0;
+		uint32_t hostRate    = 0;    // reports per second per source address
+		uint32_t hostBurst   = 0;
+		uint32_t maxGroups   = 0;    // groups per interface
+	} limits;
+
+	struct InterfaceBuckets {
+		TokenBucket reports;
+		TokenBucket records;
+	};
+	std::vector<InterfaceBuckets> buckets;    // indexed by port
+	AddressMap<TokenBucket>       hosts;
+
+	// hosts tracked at once for HOST_RATE
+	static constexpr size_t MAX_HOSTS = 4096;
+
+	static uint32_t burst(uint32_t rate, uint32_t burst) { return burst ? burst : rate; }
+
+	// the limit keywords, for configure and the limits write handler
+	static Args& limitArgs(Args& args, Limits& limits);
+
+	// reassign the buckets after the limits changed
+	void applyLimits();
+
+	// True if the buckets have room for the report, which takes its tokens then. Otherwise the
+	// groups of the report can't be tracked anymore.
+	bool admit(uint32_t interface, Packet* packet, const ReportParser& parser);
+
+	static String readLimits(Element* e, void* thunk);
+	static int    writeLimits(const String& str, Element* e, void* thunk, ErrorHandler* errh);
+
+	// apply every record of a valid report that came in on the interface
+	void applyReport(uint32_t interface, IPAddress host, const ReportParser& parser);
+
+	// ASYNC: hand a checked report or query to the task, or drop it by the policy. Safe from any
+	// thread, it only touches the queue and counters.
+	void enqueue(uint32_t interface, Packet* packet, const ReportParser& parser,
+	             const QueryMessage* query = nullptr);
+
+	enum class DropPolicy { TAIL, REFRESH };
+
+	// the parser points into the packet, which stays alive until the report is applied
+	struct QueuedReport {
+		Packet*             packet = nullptr;
+		ReportParser        parser;
+		uint32_t            interface = 0;
+		const QueryMessage* query     = nullptr;    // set instead of the parser for a query
+	};
+
+	bool                   async         = false;
+	uint32_t               queueCapacity = 1024;
+	DropPolicy             dropPolicy    = DropPolicy::TAIL;
+	MpscRing<QueuedReport> queue;
+	Task                   task;
+
+	// Queue slots held per sending host, counted by a hash of its address. Hosts that hash alike
+	// share one count, that only makes the cap stricter for them.
+	static constexpr uint32_t HOST_QUEUE_BITS = 10;
+	uint32_t                  hostQueue       = 0;
+	std::vector<uint32_t>     hostQueued;
+
+	uint32_t& queuedBy(const Packet* packet);
+
+	// reports applied per run of the task
+	static constexpr unsigned DRAIN_BURST = 64;
+
+	static String readQueue(Element* e, void* thunk);
+
+	// Adds one to a receive counter. Only ASYNC lets several threads add to it, the single
+	// threaded path keeps a plain increment.
+	void countShared(uint64_t& counter) {
+		if (async) __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+		else counter++;
+	}
+
+	// The state of the record's group on an interface, created and armed when it's new and the
+	// record can make a host want it. nullptr when it's new and the record can't, or the interface
+	// is at MAX_GROUPS.
+	GroupData* findGroup(Groups& groups, uint32_t interface, const GroupRecord& record);
+
+	// the state of a source in a group, created with a stopped timer when it's new
+	SourceData& findSource(GroupData& group, IPAddress address);
+
+	// arm the timer of a source, 0 stops it
+	void armSource(SourceData& source, uint32_t msec);
+
+	// delete the sources of the group the record doesn't list
+	void removeUnlisted(GroupData& group, const GroupRecord& record);
+
+	// the query procedures of the group, allocated when none ran yet
+	static GroupQueries& startQueries(GroupData& group);
+
+	// free the query procedures of the group once neither runs anymore
+	static void endQueries(GroupData& group);
+
+	// start the group specific queries, Q(G)
+	void queryGroup(GroupData& group);
+
+	// lower the source timers to LMQT and start the group and source specific queries, Q(G, S)
+	void querySources(GroupData& group, const std::vector<IPAddress>& sources);
+
+	// apply a group record from host to the group's state, RFC 3376 6.4
+	// false if a fast leave removed the group
+	bool processRecord(const GroupRecord& record, GroupData& group, IPAddress host);
+
+	// EXPLICIT_TRACKING: keep the hosts that want the group, the last one to leave removes the
+	// group at once instead of starting the last member queries
+	bool tracking = false;
+
+	// update the hosts of the group with a record from host
+	static void trackHost(GroupData& group, const GroupRecord& record, IPAddress host);
+
+	// the limits dropped a report before it was tracked, its groups become uncertain
+	void untrackReport(uint32_t interface, const ReportParser& parser);
+
+	// hosts tracked per group, more than this leaves the group uncertain
+	static constexpr size_t MAX_TRACKED_HOSTS = 256;
+
+	static String readHosts(Element* e, void* thunk);
+
+	// the sources that fit in one query without fragmenting at an mtu of 1500
+	static constexpr size_t MAX_QUERY_SOURCES =
+	    (1500 - sizeof(click_ip) - sizeof(RouterAlertOption) - sizeof(QueryMessage)) /
+	    sizeof(in_addr);
+
+	// Queries only depend on the protocol variables of the state, so they are built once and
+	// rebuilt when the version of the state changes. Group specific queries are patched per send.
+	struct QueryCache {
+		bool         valid   = false;
+		uint32_t     version = 0;
+		QueryMessage general;
+		QueryMessage specific;    // group and S flag left 0
+	} queries;
+
+	const QueryCache& queryCache();
+
+	// a packet holding the message, with headroom for the ip header and router alert option
+	Packet* makeQuery(const QueryMessage& msg);
+
+	IGMPRouterState* state = nullptr;
+	IGMPLogger       logger;
+
+	// general queries, the first ones are sent at the startup query interval
+	WheelTimer generalTimer;
+	uint32_t   startupQueries = 0;
+
+	// Counted on the router's home thread. With ASYNC the receive counters are shared by the
+	// threads that push into the inputs, those go through countShared().
+	struct Stats {
+		// receive
+		uint64_t packetsIn       = 0;
+		uint64_t droppedNoAlert  = 0;
+		uint64_t droppedChecksum = 0;
+		uint64_t droppedType     = 0;
+		uint64_t droppedLength   = 0;
+
+		// ASYNC, the queue side
+		uint64_t queued           = 0;
+		uint64_t queueMax         = 0;
+		uint64_t droppedQueueFull = 0;
+		uint64_t droppedRefresh   = 0;
+		uint64_t droppedHostQueue = 0;
+
+		uint64_t packetsOut    = 0;
+		uint64_t reports       = 0;
+		uint64_t records       = 0;
+		uint64_t queries       = 0;
+		uint64_t timersArmed   = 0;
+		uint64_t groupsCreated = 0;
+		uint64_t groupsExpired = 0;
+
+		// admission
+		uint64_t droppedReportRate = 0;
+		uint64_t droppedRecordRate = 0;
+		uint64_t droppedHostRate   = 0;
+		uint64_t droppedMaxGroups  = 0;
+
+		uint64_t fastLeaves = 0;
+
+		// election
+		uint64_t queriesReceived = 0;
+		uint64_t querierChanges  = 0;
+	} stats;
+
+#if HAVE_BATCH
+	// groups already looked up in the batch that is being processed
+	struct BatchGroup {
+		IPAddress  address;
+		GroupData* group;
+		bool       refreshed;    // an EXCLUDE {} record already re-armed the group timer
+	};
+	std::vector<BatchGroup> batchGroups;
+
+	// past this many groups a batch falls back to a lookup per record
+	static constexpr size_t MAX_BATCH_GROUPS = 32;
+#endif
 };
 
 CLICK_ENDDECLS
@@ -1,46 +1,200 @@
 #include <click/config.h>
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/straccum.hh>
 #include "IGMPRouterFilter.hh"
+#include "IGMPMessages.hh"
 
 CLICK_DECLS
 int IGMPRouterFilter::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
 	if (Args(conf, this, errh)
 	        .read_mp("STATE", ElementCastArg("IGMPRouterState"), state)
+	        .read("LOGLEVEL", level)
 	        .complete()) {
 		return errh->error("Could not parse IGMPRouterState");
 	}
 
+	return logger.configure(level, errh);
+}
+
+int IGMPRouterFilter::initialize(ErrorHandler*) {
+	fanout.assign(noutputs(), 0);
+	reader = state->forwarding.addReader();
+#if HAVE_BATCH
+	buckets.resize(MAX_BUCKETS);
+#endif
 	return 0;
 }
 
+void IGMPRouterFilter::add_handlers() {
+	logger.addHandlers(this);
+
+	addCounter(this, "packets_in", stats.packetsIn);
+	addCounter(this, "packets_out", stats.packetsOut);
+	addCounter(this, "no_listeners", stats.noListeners);
+	addCounter(this, "bytes_cloned", stats.bytesCloned);
+	addCounter(this, "lookups", stats.lookups);
+	add_read_handler("fanout", &readFanout, nullptr);
+	add_write_handler("reset", &writeReset, nullptr, Handler::f_button);
+}
+
+String IGMPRouterFilter::readFanout(Element* e, void*) {
+	auto        filter = (IGMPRouterFilter*) e;
+	StringAccum sa;
+	for (size_t i = 0; i < filter->fanout.size(); i++) sa << i << ' ' << filter->fanout[i] << '\n';
+	return sa.take_string();
+}
+
+int IGMPRouterFilter::writeReset(const String&, Element* e, void*, ErrorHandler*) {
+	auto filter   = (IGMPRouterFilter*) e;
+	filter->stats = Stats{};
+	std::fill(filter->fanout.begin(), filter->fanout.end(), 0);
+	return 0;
+}
+
+void IGMPRouterFilter::forward(int port, Packet* packet, bool last) {
+	stats.packetsOut++;
+	fanout[port]++;
+	if (last) {
+		output(port).push(packet);
+		return;
+	}
+	stats.bytesCloned += packet->length();
+	if (auto clone = packet->clone()) output(port).push(clone);
+}
+
 void IGMPRouterFilter::push(int input, Packet* packet) {
 	// Idk if this actually doesn't happen, just for safety
-	if (input < 0) return;
-//	click_chatter("router filter received packet on interface %u", input);
+	if (input < 0) {
+		packet->kill();
+		return;
+	}
+	stats.packetsIn++;
 
 	// group address
 	auto address = IPAddress(packet->ip_header()->ip_dst);
 
+	// every port but the last gets a clone, the last one the packet itself
+	auto last = -1;
+	auto send = [&](int port) {
+		if (last >= 0) forward(last, packet, false);
+		last = port;
+	};
+
 	// exception for 224.0.0.1 which should always be forwarded
-    if (address == IPAddress("224.0.0.1")) {
-		for(auto i = 0; i < noutputs(); i++) output(i).push(packet->clone());
-		return;
+	if (address == ALL_SYSTEMS) {
+		for (auto i = 0; i < noutputs(); i++) send(i);
+	} else {
+		// the interfaces that have someone listening to this source in this group
+		ForwardingTable::ReadSection view(state->forwarding, reader);
+		auto ports = view->ports(IPAddress(packet->ip_header()->ip_src), address);
+		stats.lookups++;
+		if (ports) {
+			ports->forEach([&](uint32_t port) {
+				if (int(port) < noutputs()) send(int(port));
+			});
+		} else {
+			stats.noListeners++;
+		}
+	}
+
+	if (last >= 0) {
+		forward(last, packet, true);
+	} else {
+		packet->kill();
+	}
+}
+
+#if HAVE_BATCH
+void IGMPRouterFilter::forwardBatch(int port, const std::vector<Packet*>& packets, bool last) {
+	PacketBatch* out = nullptr;
+	for (auto packet : packets) {
+		if (!last) {
+			stats.bytesCloned += packet->length();
+			packet = packet->clone();
+			if (!packet) continue;
+		}
+		if (out) {
+			out->append_packet(packet);
+		} else {
+			out = PacketBatch::make_from_packet(packet);
+		}
 	}
+	if (!out) return;
 
+	stats.packetsOut += out->count();
+	fanout[port] += out->count();
+	output_push_batch(port, out);
+}
+
+void IGMPRouterFilter::flushBuckets() {
+	// one read section for all the buckets, the lookups see the same version of the state
+	ForwardingTable::ReadSection view(state->forwarding, reader);
+	for (size_t i = 0; i < usedBuckets; i++) {
+		auto& bucket = buckets[i];
+
+		// as in push, every port but the last gets clones and the last one the packets themselves
+		auto last = -1;
+		auto send = [&](int port) {
+			if (last >= 0) forwardBatch(last, bucket.packets, false);
+			last = port;
+		};
+
+		if (bucket.address == ALL_SYSTEMS) {
+			for (auto port = 0; port < noutputs(); port++) send(port);
+		} else {
+			auto ports = view->ports(bucket.source, bucket.address);
+			stats.lookups++;
+			if (ports) {
+				ports->forEach([&](uint32_t port) {
+					if (int(port) < noutputs()) send(int(port));
+				});
+			} else {
+				stats.noListeners += bucket.packets.size();
+			}
+		}
+
+		if (last >= 0) {
+			forwardBatch(last, bucket.packets, true);
+		} else {
+			for (auto packet : bucket.packets) packet->kill();
+		}
+		bucket.packets.clear();
+	}
+	usedBuckets = 0;
+}
 
-	for (auto& interface : state->interfaces) {
-		// This means this specific interface doesn't recognise the group address.
-		if (interface.second.find(address) == interface.second.end()) continue;
+void IGMPRouterFilter::push_batch(int, PacketBatch* batch) {
+	// sort the packets into buckets per (source, group) first, so every flow is looked up once
+	// per batch and each port gets its clones as a single batch
+	FOR_EACH_PACKET_SAFE(batch, packet) {
+		stats.packetsIn++;
+		auto source  = IPAddress(packet->ip_header()->ip_src);
+		auto address = IPAddress(packet->ip_header()->ip_dst);
 
-		auto& group = interface.second[address];
-		click_chatter("in filter: %s -> %s", address.unparse().c_str(),
-		              group.isExclude ? "true" : "false");
+		size_t i = 0;
+		while (i < usedBuckets &&
+		       (buckets[i].address != address || buckets[i].source != source))
+			i++;
+		if (i == MAX_BUCKETS) {
+			flushBuckets();
+			i = 0;
+		}
+		if (i == usedBuckets) {
+			buckets[i].source  = source;
+			buckets[i].address = address;
+			usedBuckets++;
+		}
 
-		// Check if someone wants this by looking if mode for group is exclude
-		if (group.isExclude) { output(int(interface.first)).push(packet->clone()); }
+		// the buckets own the packets from here on
+		packet->set_next(nullptr);
+		buckets[i].packets.push_back(packet);
 	}
+	flushBuckets();
 }
+#endif
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IGMPForwarding)
 EXPORT_ELEMENT(IGMPRouterFilter)
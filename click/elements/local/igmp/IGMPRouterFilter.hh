@@ -3,10 +3,14 @@
 
 #include <click/element.hh>
 #include "IGMPRouterState.hh"
+#include "IGMPBatch.hh"
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
+#include <vector>
 
 CLICK_DECLS
 
-class IGMPRouterFilter: public Element {
+class IGMPRouterFilter: public IGMPBatchElement {
 public:
 	const char* class_name() const override { return "IGMPRouterFilter"; }
 
@@ -16,10 +20,61 @@ public:
 
 	int configure(Vector<String>&, ErrorHandler*) override;
 
+	int initialize(ErrorHandler*) override;
+
+	void add_handlers() override;
+
 	void push(int, Packet*) override;
+#if HAVE_BATCH
+	void push_batch(int, PacketBatch*) override;
+#endif
 
 private:
+	// send a clone of the packet to a port and count it, the packet itself for the last port
+	inline void forward(int port, Packet* packet, bool last);
+
+#if HAVE_BATCH
+	// The packets of one batch with the same source and destination group, the forwarding state
+	// is looked up once for all of them. The vectors are kept between batches so they don't
+	// allocate after warmup.
+	struct Bucket {
+		IPAddress            source;
+		IPAddress            address;
+		std::vector<Packet*> packets;
+	};
+
+	// a burst rarely carries many groups, when it does the buckets are flushed early
+	static constexpr size_t MAX_BUCKETS = 16;
+
+	std::vector<Bucket> buckets;
+	size_t              usedBuckets = 0;
+
+	// send a batch of clones of the packets to a port, the packets themselves for the last port
+	void forwardBatch(int port, const std::vector<Packet*>& packets, bool last);
+
+	// forward and release the packets in every bucket
+	void flushBuckets();
+#endif
+
 	IGMPRouterState* state;
+	IGMPLogger       logger;
+
+	// slot of this filter in the read sections of the forwarding table
+	uint32_t reader = 0;
+
+	struct Stats {
+		uint64_t packetsIn   = 0;
+		uint64_t packetsOut  = 0;
+		uint64_t noListeners = 0;
+		uint64_t bytesCloned = 0;
+		uint64_t lookups     = 0;
+	} stats;
+
+	// packets sent per output port
+	std::vector<uint64_t> fanout;
+
+	static String readFanout(Element* e, void* thunk);
+	static int    writeReset(const String& conf, Element* e, void* thunk, ErrorHandler* errh);
 };
 
 CLICK_ENDDECLS
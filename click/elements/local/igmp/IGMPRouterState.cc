@@ -4,5 +4,121 @@
 
 CLICK_DECLS
 
+int IGMPRouterState::initialize(ErrorHandler*) {
+	wheel.initialize(this);
+	return 0;
+}
+
+void IGMPRouterState::add_handlers() {
+	add_read_handler("groups", &readSize, nullptr);
+	add_read_handler("capacity", &readCapacity, nullptr);
+	add_read_handler("timers", &readTimers, nullptr);
+	add_read_handler("publishes", &readPublishes, nullptr);
+}
+
+size_t IGMPRouterState::size() const {
+	size_t result = 0;
+	for (const auto& groups : interfaces) result += groups.size();
+	return result;
+}
+
+size_t IGMPRouterState::capacity() const {
+	size_t result = 0;
+	for (const auto& groups : interfaces) {
+		result += groups.capacity();
+		for (const auto& group : groups) result += group.sources.capacity();
+	}
+	return result;
+}
+
+String IGMPRouterState::readCapacity(Element* e, void*) {
+	return String(uint64_t(((IGMPRouterState*) e)->capacity()));
+}
+
+String IGMPRouterState::readSize(Element* e, void*) {
+	return String(uint64_t(((IGMPRouterState*) e)->size()));
+}
+
+String IGMPRouterState::readTimers(Element* e, void*) {
+	return String(uint64_t(((IGMPRouterState*) e)->wheel.size()));
+}
+
+String IGMPRouterState::readPublishes(Element* e, void*) {
+	return String(((IGMPRouterState*) e)->forwarding.publishes);
+}
+
+bool IGMPRouterState::adopt(uint32_t qrv, uint32_t qi) {
+	if (!qrv) qrv = robustness;
+	if (!qi) qi = queryInterval;
+	if (qrv == robustness && qi == queryInterval) return false;
+
+	robustness              = qrv;
+	queryInterval           = qi;
+	groupMembershipInterval = robustness * queryInterval + queryResponseInterval;
+	startupQueryInterval    = queryInterval >> 2;
+	startupQueryCount       = robustness;
+	lastMemberQueryCount    = robustness;
+	lastMemberQueryTime     = lastMemberQueryInterval * lastMemberQueryCount;
+	version++;
+	return true;
+}
+
+void IGMPRouterState::refresh(IPAddress address) {
+	// the interfaces in EXCLUDE mode take any source, and every source with state somewhere
+	GroupForwarding        entry;
+	std::vector<IPAddress> sources;
+	for (uint32_t port = 0; port < interfaces.size(); port++) {
+		auto group = interfaces[port].find(address);
+		if (!group) continue;
+
+		if (group->isExclude) entry.any.set(port);
+		for (const auto& source : group->sources) sources.push_back(source.address);
+	}
+
+	// sorted the way the entry looks them up
+	std::sort(sources.begin(), sources.end(),
+	          [](IPAddress a, IPAddress b) { return a.addr() < b.addr(); });
+	sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+	for (auto source : sources) {
+		PortMask mask;
+		for (uint32_t port = 0; port < interfaces.size(); port++) {
+			auto group = interfaces[port].find(address);
+			if (group && group->forwards(source)) mask.set(port);
+		}
+
+		// a source that gets the same as any other source is served by any
+		if (mask == entry.any) continue;
+		entry.sources.push_back({ source.addr(), mask });
+	}
+	forwarding.set(address, std::move(entry));
+}
+
+void IGMPRouterState::removeSource(GroupData& group, IPAddress source) {
+	auto data = group.sources.find(source);
+	if (!data) return;
+
+	wheel.unschedule(&data->timer);
+	group.sources.erase(source);
+}
+
+void IGMPRouterState::removeGroup(uint32_t interface, IPAddress address) {
+	if (interface >= interfaces.size()) return;
+
+	auto group = interfaces[interface].find(address);
+	if (!group) return;
+
+	wheel.unschedule(&group->groupTimer);
+	if (group->queries) {
+		wheel.unschedule(&group->queries->sendTimer);
+		wheel.unschedule(&group->queries->sourceQueryTimer);
+	}
+	for (auto& source : group->sources) wheel.unschedule(&source.timer);
+	interfaces[interface].erase(address);
+
+	refresh(address);
+}
+
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IGMPTimerWheel IGMPForwarding)
 EXPORT_ELEMENT(IGMPRouterState)
@@ -3,29 +3,83 @@
 
 #include <click/element.hh>
 #include "IGMPClientState.hh"
+#include "IGMPTimerWheel.hh"
+#include "IGMPAddressMap.hh"
+#include "IGMPForwarding.hh"
 
-#include <unordered_set>
-#include <unordered_map>
-#include <tuple>
+#include <algorithm>
+#include <memory>
 #include <vector>
 
-// source address -> source timer
-// using Sources = std::unordered_map<IPAddress, Timer*, Hash>;
-// we can simplify this by not storing the sources and only keeping a timer
+class IGMPRouter;
+struct GroupData;
+
+// One source of a group on an interface, RFC 3376 6.2.
+// In INCLUDE mode traffic from the source is forwarded while its timer runs, the source is deleted
+// when the timer expires. In EXCLUDE mode a running timer means the source is requested, a stopped
+// timer means it is excluded.
+struct SourceData {
+	GroupData* group = nullptr;
+	IPAddress  address;
+	WheelTimer timer;
+};
+
+// source address -> source state
+using Sources = AddressMap<SourceData>;
+
+// The query procedures of a group, only allocated while one of them runs. Most groups are only
+// ever refreshed and would carry these timers and the source list for nothing.
+struct GroupQueries {
+	// last member procedure: resends the group specific query
+	WheelTimer sendTimer;
+	uint32_t   numResends = 0;
+	bool       first      = false;
+
+	// resends the group and source specific query for querySources
+	WheelTimer             sourceQueryTimer;
+	uint32_t               sourceResends = 0;
+	std::vector<IPAddress> querySources;
+
+	bool idle() const { return !sendTimer.scheduled() && !sourceQueryTimer.scheduled(); }
+};
 
+// The timers live inside the group, so they are gone as soon as the group is erased. Groups and
+// sources stay at the same place in their AddressMap, timers and sources point back to them.
 struct GroupData {
-	Timer* groupTimer;
-	Timer* sendTimer;
-	bool   isExclude;
+	IGMPRouter* router    = nullptr;
+	uint32_t    interface = 0;
+	IPAddress   address;
+
+	// expires the group, is reset on every report that wants to listen
+	WheelTimer groupTimer;
+
+	// nullptr while no query procedure runs
+	std::unique_ptr<GroupQueries> queries;
+
+	bool    isExclude = false;
+	Sources sources;
+
+	// explicit tracking: the hosts that reported interest, uncertain once a host couldn't be
+	// tracked so an empty set doesn't prove nobody listens
+	AddressSet hosts;
+	bool       hostsUncertain = false;
+
+	// true if traffic from this source should be forwarded on the group's interface
+	bool forwards(IPAddress source) const {
+		auto data = sources.find(source);
+		if (isExclude) return !data || data->timer.scheduled();
+		return data && data->timer.scheduled();
+	}
 };
 
 constexpr bool DEBUG = true;
 
 // group address -> state
-using Groups = std::unordered_map<IPAddress, GroupData, Hash>;
+using Groups = AddressMap<GroupData>;
 
-// interface id -> group
-using Interfaces = std::unordered_map<uint32_t, Groups>;
+// The groups of every interface, indexed by port. The router sizes it for its ports at configure
+// time, before any group exists.
+using Interfaces = std::vector<Groups>;
 
 CLICK_DECLS
 class IGMPRouterState: public Element {
@@ -34,8 +88,57 @@ public:
 
 	const char* port_count() const override { return "0"; }
 
+	int initialize(ErrorHandler*) override;
+
+	void add_handlers() override;
+
 	Interfaces interfaces;
 
+	// Drives every group and query timer of the router with a single Click timer.
+	// Ticks are 100ms, the unit all the intervals below are expressed in.
+	TimerWheel wheel{ 100 };
+
+	// Precomputed view of `interfaces` for the data path, only change it through the functions
+	// below so both stay in sync. The filters read it from other threads, everything else in the
+	// state belongs to the thread of the router, which has to be the thread of the state as well
+	// because of the timers. Publish after changing groups so the filters see it.
+	ForwardingTable forwarding;
+
+	// Rebuild the forwarding entries of a group from the state on every interface. Call this after
+	// changing the filter mode or the sources of the group anywhere.
+	void refresh(IPAddress address);
+
+	// remove a source from a group, with its timer
+	void removeSource(GroupData& group, IPAddress source);
+
+	// remove a group from an interface, including its forwarding entries and timers
+	void removeGroup(uint32_t interface, IPAddress address);
+
+	// amount of groups over all interfaces
+	size_t size() const;
+
+	// groups and sources the maps have room for over all interfaces
+	size_t capacity() const;
+
+	static String readSize(Element* e, void* thunk);
+	static String readCapacity(Element* e, void* thunk);
+	static String readTimers(Element* e, void* thunk);
+	static String readPublishes(Element* e, void* thunk);
+
+	// Take over the robustness and query interval of the querier, RFC 3376 4.1.6 and 4.1.7, 0
+	// keeps ours. The intervals that follow from them are recomputed, false if nothing changed.
+	bool adopt(uint32_t robustness, uint32_t queryInterval);
+
+	// Other Querier Present Interval, how long a router stays silent after a query from a lower
+	// address: robustness times the query interval plus half a query response interval
+	uint32_t otherQuerierPresentInterval() const {
+		return robustness * queryInterval + queryResponseInterval / 2;
+	}
+
+	// Bump this after changing any of the protocol variables below, the router rebuilds the
+	// queries it has cached when it sees a new version.
+	uint32_t version = 0;
+
 	// The Robustness Variable allows tuning for the expected packet loss on a network.
 	// IGMP is robust to (Robustness Variable - 1) packet losses.
 	// The Robustness Variable MUST NOT be zero, and SHOULD NOT be one.
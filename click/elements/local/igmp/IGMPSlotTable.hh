@@ -0,0 +1,105 @@
+#ifndef CLICK_IGMPSLOTTABLE_HH
+#define CLICK_IGMPSLOTTABLE_HH
+
+#include <click/glue.hh>
+#include <cstdint>
+#include <vector>
+
+CLICK_DECLS
+
+// Fibonacci hashing, the top bits of the key times 2^32 / phi. Neighbouring group addresses end up
+// spread over all 2^bits results.
+inline uint32_t fibonacciHash(uint32_t key, uint32_t bits) {
+	return uint32_t(key * 2654435769u) >> (32 - bits);
+}
+
+// The table under AddressSet and AddressMap: open addressing on IPv4 addresses with linear
+// probing, kept at most half full. A Slot has a uint32_t key, 0 marks an empty slot, whatever
+// else it holds moves along with its key. Nothing is allocated before the first insert.
+template <typename Slot>
+class SlotTable {
+public:
+	static constexpr size_t NONE = size_t(-1);
+
+	// position of the key's slot, NONE if it isn't there
+	size_t find(uint32_t key) const {
+		if (!key || slots.empty()) return NONE;
+		for (auto i = home(key);; i = (i + 1) & mask()) {
+			if (slots[i].key == key) return i;
+			if (!slots[i].key) return NONE;
+		}
+	}
+
+	// The key's slot, created is set when it is new and only has its key filled in. The key must
+	// not be 0, the slot moves on the next insert or erase.
+	Slot& insert(uint32_t key, bool& created) {
+		if (slots.empty()) {
+			slots.assign(MIN_CAPACITY, Slot{});
+		} else if ((count + 1) * 2 > slots.size()) {
+			grow();
+		}
+
+		auto i = home(key);
+		for (; slots[i].key; i = (i + 1) & mask()) {
+			if (slots[i].key != key) continue;
+			created = false;
+			return slots[i];
+		}
+		slots[i]     = Slot{};
+		slots[i].key = key;
+		count++;
+		created = true;
+		return slots[i];
+	}
+
+	// empties the slot at a position find() returned
+	void erase(size_t i) {
+		// shift the following entries of the cluster back instead of leaving a tombstone
+		for (auto j = (i + 1) & mask(); slots[j].key; j = (j + 1) & mask()) {
+			auto k = home(slots[j].key);
+			if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+				slots[i] = slots[j];
+				i        = j;
+			}
+		}
+		slots[i] = Slot{};
+		count--;
+	}
+
+	const Slot& operator[](size_t i) const { return slots[i]; }
+
+	size_t size() const { return count; }
+
+	// every slot in table order, the empty ones included
+	const Slot* begin() const { return slots.data(); }
+	const Slot* end() const { return slots.data() + slots.size(); }
+
+private:
+	static constexpr uint32_t MIN_BITS     = 4;
+	static constexpr uint32_t MIN_CAPACITY = 1 << MIN_BITS;
+
+	std::vector<Slot> slots;    // empty until the first insert
+	uint32_t          bits  = MIN_BITS;
+	size_t            count = 0;
+
+	size_t mask() const { return slots.size() - 1; }
+
+	size_t home(uint32_t key) const { return fibonacciHash(key, bits); }
+
+	void grow() {
+		std::vector<Slot> old(slots.size() * 2, Slot{});
+		old.swap(slots);
+		bits++;
+
+		for (auto& slot : old) {
+			if (!slot.key) continue;
+			auto i = home(slot.key);
+			while (slots[i].key) i = (i + 1) & mask();
+			slots[i] = slot;
+		}
+	}
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPSLOTTABLE_HH
@@ -0,0 +1,30 @@
+#ifndef CLICK_IGMPSTATS_HH
+#define CLICK_IGMPSTATS_HH
+
+#include <click/element.hh>
+#include <click/string.hh>
+
+CLICK_DECLS
+
+// Counters are plain per-element integers, they are only touched by the thread running the element
+// so the push paths don't need any locking. Where several threads add to one the element uses a
+// relaxed atomic add, reading it needs nothing more.
+
+// read handler for a single counter, the thunk points to the counter
+inline String readCounter(Element*, void* thunk) { return String(*(const uint64_t*) thunk); }
+
+// write handler that zeroes a whole counter struct, the thunk points to the struct
+template <typename T>
+int resetCounters(const String&, Element*, void* thunk, ErrorHandler*) {
+	*(T*) thunk = T{};
+	return 0;
+}
+
+// register a read handler for one counter
+inline void addCounter(Element* e, const char* name, uint64_t& counter) {
+	e->add_read_handler(name, &readCounter, &counter);
+}
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPSTATS_HH
@@ -0,0 +1,107 @@
+#include <click/config.h>
+#include "IGMPTimerWheel.hh"
+#include <algorithm>
+
+CLICK_DECLS
+
+TimerWheel::TimerWheel(uint32_t tickMsec) : tickMsec(tickMsec), timer(&handleTimer, this) {
+	for (auto& head : slots) head.prev = head.next = &head;
+}
+
+TimerWheel::~TimerWheel() {
+	// leave the owners with consistent timers, nothing is freed here
+	for (auto& head : slots) {
+		while (head.next != &head) unlink(head.next);
+	}
+}
+
+void TimerWheel::initialize(Element* owner) {
+	start = Timestamp::now_steady();
+	timer.initialize(owner);
+	if (count) timer.schedule_after_msec(tickMsec);
+}
+
+uint64_t TimerWheel::now() const {
+	if (!timer.initialized()) return current;
+	return uint64_t((Timestamp::now_steady() - start).msecval()) / tickMsec;
+}
+
+void TimerWheel::schedule(WheelTimer* t, uint32_t msec) {
+	if (t->scheduled()) unlink(t);
+
+	// round up so a timer never fires early, and never in the tick that is running
+	auto base = std::max(now(), current);
+	t->expiry = base + std::max(1u, (msec + tickMsec - 1) / tickMsec);
+
+	link(&slots[t->expiry % SLOTS], t);
+	if (timer.initialized() && !timer.scheduled()) timer.schedule_after_msec(tickMsec);
+}
+
+void TimerWheel::unschedule(WheelTimer* t) {
+	if (t->scheduled()) unlink(t);
+}
+
+uint32_t TimerWheel::remainingMsec(const WheelTimer* t) const {
+	if (!t->scheduled()) return 0;
+	auto base = std::max(now(), current);
+	return t->expiry > base ? uint32_t(t->expiry - base) * tickMsec : 0;
+}
+
+void TimerWheel::link(WheelTimer* head, WheelTimer* t) {
+	t->prev          = head->prev;
+	t->next          = head;
+	head->prev->next = t;
+	head->prev       = t;
+	count++;
+}
+
+void TimerWheel::unlink(WheelTimer* t) {
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->prev = t->next = nullptr;
+	count--;
+}
+
+void TimerWheel::run() {
+	auto target = now();
+
+	// after a stall one revolution visits every slot, which fires everything that is due
+	if (target - current > SLOTS) current = target - SLOTS;
+
+	while (current < target && count) {
+		current++;
+		auto& head = slots[current % SLOTS];
+
+		// Timers that belong to a later revolution are parked here and put back afterwards.
+		// Callbacks may arm or cancel any timer, including the ones in this slot, because
+		// every list stays consistent while we pop one timer at a time.
+		WheelTimer later;
+		later.prev = later.next = &later;
+
+		while (head.next != &head) {
+			auto t = head.next;
+			unlink(t);
+
+			if (t->expiry > current) {
+				link(&later, t);
+			} else {
+				t->callback(t, t->data);
+			}
+		}
+
+		while (later.next != &later) {
+			auto t = later.next;
+			unlink(t);
+			link(&head, t);
+		}
+	}
+
+	// nothing has to happen in between, so jump the idle ticks at once
+	if (!count) current = target;
+	if (count) timer.schedule_after_msec(tickMsec);
+}
+
+void TimerWheel::handleTimer(Timer*, void* data) { ((TimerWheel*) data)->run(); }
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IGMPTimerWheel)
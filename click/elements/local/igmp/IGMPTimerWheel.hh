@@ -0,0 +1,85 @@
+#ifndef CLICK_IGMPTIMERWHEEL_HH
+#define CLICK_IGMPTIMERWHEEL_HH
+
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/timestamp.hh>
+
+CLICK_DECLS
+
+class TimerWheel;
+
+// Intrusive timer, embed it in the state it belongs to so arming it never allocates.
+// It must not move or be destroyed while it is scheduled.
+class WheelTimer {
+public:
+	using Callback = void (*)(WheelTimer*, void*);
+
+	WheelTimer() = default;
+	WheelTimer(const WheelTimer&) = delete;
+	WheelTimer& operator=(const WheelTimer&) = delete;
+
+	void assign(Callback f, void* d) {
+		callback = f;
+		data     = d;
+	}
+
+	bool scheduled() const { return next != nullptr; }
+
+private:
+	friend class TimerWheel;
+
+	WheelTimer* prev     = nullptr;
+	WheelTimer* next     = nullptr;
+	uint64_t    expiry   = 0;    // in ticks since the wheel started
+	Callback    callback = nullptr;
+	void*       data     = nullptr;
+};
+
+// Hashed timing wheel driven by a single Click Timer. Arming, re-arming and cancelling are O(1),
+// a tick only looks at the timers hashed to its slot.
+class TimerWheel {
+public:
+	explicit TimerWheel(uint32_t tickMsec = 100);
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	// initialize the underlying Click timer, timers armed before this start running now
+	void initialize(Element* owner);
+
+	// arm or re-arm a timer to expire after msec, rounded up to at least one tick
+	void schedule(WheelTimer* timer, uint32_t msec);
+
+	void unschedule(WheelTimer* timer);
+
+	// time left before a timer expires, 0 if it isn't scheduled
+	uint32_t remainingMsec(const WheelTimer* timer) const;
+
+	size_t size() const { return count; }
+
+	uint32_t tick() const { return tickMsec; }
+
+private:
+	static constexpr uint32_t SLOTS = 512;
+
+	uint32_t   tickMsec;
+	uint64_t   current = 0;    // last tick that has been run
+	size_t     count   = 0;
+	Timestamp  start;
+	Timer      timer;
+	WheelTimer slots[SLOTS];    // list heads, circular
+
+	uint64_t now() const;
+
+	void link(WheelTimer* head, WheelTimer* timer);
+	void unlink(WheelTimer* timer);
+
+	void        run();
+	static void handleTimer(Timer*, void* data);
+};
+
+CLICK_ENDDECLS
+
+#endif    // CLICK_IGMPTIMERWHEEL_HH
@@ -3,49 +3,63 @@
 #include <clicknet/ether.h>
 #include "alertEncap.hh"
 #include "IGMPMessages.hh"
+#include "IGMPChecksum.hh"
 
 CLICK_DECLS
-void AlertEncap::push(int, Packet* packet) {
-	// maybe some checks to be sure we received an ip packet?
-	const auto header = packet->ip_header();
-	const auto length = header->ip_hl * 4u;
-
-	const auto option = RouterAlertOption{};
-	auto       new_packet =
-		Packet::make(sizeof(click_ether) + 4, nullptr, packet->length() + sizeof(option), 0);
+int AlertEncap::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
+	if (Args(conf, this, errh).read("LOGLEVEL", level).complete() < 0) return -1;
+	return logger.configure(level, errh);
+}
 
-	// add the ip header
-	memcpy(new_packet->data(), packet->data(), length);
+void AlertEncap::add_handlers() {
+	logger.addHandlers(this);
 
-	// add the ip option
-	memcpy(new_packet->data() + length, &option, sizeof(option));
+	addCounter(this, "packets", stats.packets);
+	addCounter(this, "bytes_copied", stats.bytesCopied);
+	addCounter(this, "reallocated", stats.reallocated);
+	addCounter(this, "drops", stats.dropped);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+}
 
-	// add the rest of the packet
-	memcpy(new_packet->data() + length + sizeof(option), packet->data() + length,
-	       packet->length() - length);
+void AlertEncap::push(int, Packet* packet) {
+	// maybe some checks to be sure we received an ip packet?
+	const auto length = packet->ip_header()->ip_hl * 4u;
+	const auto option = RouterAlertOption{};
 
-	// Maybe do this instead if something breaks
-	// packet->copy_annotations()
+	// without headroom, or when the packet is shared, push has to copy it after all
+	if (packet->shared() || packet->headroom() < sizeof(option)) stats.reallocated++;
 
-	// set annotations for new packet for click routing
-	new_packet->set_ip_header((click_ip*) new_packet->data(), length + sizeof(option));
-	new_packet->set_dst_ip_anno(packet->dst_ip_anno());
+	// grow the packet at the front, the data stays where it is
+	auto q = packet->push(sizeof(option));
+	if (!q) {
+		IGMP_LOG(logger, ERROR, "%p{element}: could not allocate packet", this);
+		stats.dropped++;
+		return;
+	}
+	stats.packets++;
+	stats.bytesCopied += length;
 
-	// kill old packet
-	packet->kill();
+	// move the ip header to the new front and put the option in the gap behind it
+	memmove(q->data(), q->data() + sizeof(option), length);
+	memcpy(q->data() + length, &option, sizeof(option));
+	q->set_ip_header((click_ip*) q->data(), length + sizeof(option));
 
-	// get new packet header
-	auto* new_header = new_packet->ip_header();
+	auto       header = q->ip_header();
+	const auto first  = (uint16_t*) header;
 
-	// this works in increments of 4, which is the size of the option
-	new_header->ip_hl++;
-	new_header->ip_len = htons(ntohs(new_header->ip_len) + sizeof(option));
+	// the first word holds the header length, it works in increments of 4 like the option
+	auto oldFirst = *first;
+	auto oldLen   = header->ip_len;
+	header->ip_hl++;
+	header->ip_len = htons(ntohs(oldLen) + sizeof(option));
 
-	// we need to set the checksum as zero before calculating it
-	new_header->ip_sum = 0;
-	new_header->ip_sum = click_in_cksum(new_packet->data(), (int) (length + sizeof(option)));
+	// update the checksum for the changed words and the inserted option instead of recomputing it
+	header->ip_sum = updateChecksum16(header->ip_sum, oldFirst, *first);
+	header->ip_sum = updateChecksum16(header->ip_sum, oldLen, header->ip_len);
+	header->ip_sum = insertChecksum(header->ip_sum, &option, sizeof(option));
 
-	output(0).push(new_packet);
+	output(0).push(q);
 }
 
 CLICK_ENDDECLS
@@ -2,13 +2,27 @@
 #define CLICK_ALERTENCAP_HH
 
 #include <click/element.hh>
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
 
 class AlertEncap: public Element {
 	const char* class_name() const override { return "AlertEncap"; }
 	const char* port_count() const override { return "1/1"; }
 	const char* processing() const override { return PUSH; }
 
+	int  configure(Vector<String>&, ErrorHandler*) override;
+	void add_handlers() override;
+
 	void push(int, Packet*) override;
+
+	IGMPLogger logger;
+
+	struct Stats {
+		uint64_t packets     = 0;
+		uint64_t bytesCopied = 0;    // only the ip header is moved, the payload stays in place
+		uint64_t reallocated = 0;    // packets without headroom that had to be copied anyway
+		uint64_t dropped     = 0;
+	} stats;
 };
 
 #endif    // CLICK_ALERTENCAP_HH
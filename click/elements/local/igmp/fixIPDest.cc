@@ -3,27 +3,45 @@
 #include <click/error.hh>
 #include "fixIPDest.hh"
 #include "IGMPMessages.hh"
+#include "IGMPChecksum.hh"
 
 CLICK_DECLS
 FixIPDest::FixIPDest() = default;
 
 FixIPDest::~FixIPDest() = default;
 
-int FixIPDest::configure(Vector<String>& conf, ErrorHandler* errh) { return 0; }
+int FixIPDest::configure(Vector<String>& conf, ErrorHandler* errh) {
+	String level;
+	if (Args(conf, this, errh).read("LOGLEVEL", level).complete() < 0) return -1;
+	return logger.configure(level, errh);
+}
 
-void FixIPDest::push(int, Packet* p) {
-	auto packet = p->uniqueify();
+void FixIPDest::add_handlers() {
+	logger.addHandlers(this);
+
+	addCounter(this, "packets", stats.packets);
+	addCounter(this, "rewritten", stats.rewritten);
+	add_write_handler("reset", &resetCounters<Stats>, &stats, Handler::f_button);
+}
 
-	auto ip    = (click_ip*) (packet->data());
-	auto query = (QueryMessage*) (packet->data() + packet->ip_header_length());
-	auto dest  = query->groupAddress;
+void FixIPDest::push(int, Packet* p) {
+	stats.packets++;
 
+	// general queries keep their destination, they don't need a writable packet
+	auto dest = ((const QueryMessage*) (p->data() + p->ip_header_length()))->groupAddress;
 	if (!dest.s_addr) return output(0).push(p);
 
+	auto packet = p->uniqueify();
+	if (!packet) {
+		IGMP_LOG(logger, ERROR, "%p{element}: could not uniqueify packet", this);
+		return;
+	}
+	auto ip = (click_ip*) (packet->data());
+
+	// only the destination changes, so the checksum is updated rather than recomputed
+	ip->ip_sum = updateChecksum32(ip->ip_sum, ip->ip_dst.s_addr, dest.s_addr);
 	ip->ip_dst = dest;
-
-	ip->ip_sum = 0;
-	ip->ip_sum = click_in_cksum((unsigned char*) (ip), int(packet->ip_header_length()));
+	stats.rewritten++;
 
 	packet->set_dst_ip_anno(dest);
 	output(0).push(packet);
@@ -1,6 +1,8 @@
 #ifndef CLICK_IPDESTINATIONFIXER_HH
 #define CLICK_IPDESTINATIONFIXER_HH
 #include <click/element.hh>
+#include "IGMPLog.hh"
+#include "IGMPStats.hh"
 CLICK_DECLS
 
 class FixIPDest: public Element {
@@ -12,8 +14,17 @@ public:
 	const char* port_count() const override { return "1/1"; }
 	const char* processing() const override { return PUSH; }
 	int         configure(Vector<String>&, ErrorHandler*) override;
+	void        add_handlers() override;
 
 	void push(int, Packet*) override;
+
+private:
+	IGMPLogger logger;
+
+	struct Stats {
+		uint64_t packets   = 0;
+		uint64_t rewritten = 0;
+	} stats;
 };
 
 CLICK_ENDDECLS
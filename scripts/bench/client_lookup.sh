@@ -0,0 +1,15 @@
+#!/bin/sh
+# IGMPClientState lookup cost with 10, 1k and ~100k joined groups
+
+cd "$(dirname "$0")" || exit
+
+CLICK=${CLICK:-../../click/userlevel/click}
+
+echo "10 groups"
+$CLICK client_lookup.click GROUPS="225.1.0.0/29 225.1.0.8/31"
+
+echo "1000 groups"
+$CLICK client_lookup.click GROUPS="225.1.0.0/23 225.1.2.0/24 225.1.3.0/25 225.1.3.128/26 225.1.3.192/27 225.1.3.224/29"
+
+echo "100352 groups"
+$CLICK client_lookup.click GROUPS="225.1.0.0/16 225.2.0.0/17 225.3.0.0/21"
@@ -0,0 +1,20 @@
+#!/bin/sh
+# IGMPRouter report verification cost for reports of 1, 64, 512 and 4096 group records
+
+cd "$(dirname "$0")" || exit
+
+CLICK=${CLICK:-../../click/userlevel/click}
+
+for records in 1 64 512 4096; do
+	report=$((8 + records * 8))
+	length=$((24 + report))
+
+	# ip header with router alert option, to 224.0.0.22
+	data=$(printf "46c0%04x00000000010200000a000001e000001694040000" $length)
+	# report header with a checksum of 0, then empty records
+	data="${data}22000000$(printf "0000%04x" $records)"
+	data="$data$(head -c $((records * 8)) /dev/zero | od -An -v -tx1 | tr -d ' \n')"
+
+	echo "$records records, $report bytes"
+	$CLICK report_checksum.click DATA="$data" N=$((100000000 / report))
+done
@@ -0,0 +1,38 @@
+#!/bin/sh
+# IGMPRouter report parsing rate for reports of 64, 512 and 2048 EXCLUDE records,
+# without sources and with 4 sources per record
+
+cd "$(dirname "$0")" || exit
+
+CLICK=${CLICK:-../../click/userlevel/click}
+
+for sources in 0 4; do
+	for records in 64 512 2048; do
+		report=$((8 + records * (8 + sources * 4)))
+		length=$((24 + report))
+
+		# records for 225.1.0.0 and up, every source is 10.0.0.1
+		sum=$((0x2200 + records))
+		body=""
+		i=0
+		while [ $i -lt $records ]; do
+			body="$body$(printf "0200%04xe101%04x" $sources $i)"
+			s=0
+			while [ $s -lt $sources ]; do
+				body="${body}0a000001"
+				s=$((s + 1))
+			done
+			sum=$((sum + 0x0200 + sources + 0xe101 + i + sources * (0x0a00 + 0x0001)))
+			i=$((i + 1))
+		done
+		while [ $sum -gt 65535 ]; do sum=$(((sum & 0xFFFF) + (sum >> 16))); done
+		checksum=$((~sum & 0xFFFF))
+
+		# ip header with router alert option to 224.0.0.22, then the report
+		data=$(printf "46c0%04x00000000010200000a000001e000001694040000" $length)
+		data="$data$(printf "2200%04x0000%04x" $checksum $records)$body"
+
+		echo "$records records with $sources sources, $report bytes"
+		$CLICK report_parse.click DATA="$data" N=$((50000000 / report))
+	done
+done
@@ -0,0 +1,17 @@
+#!/bin/sh
+# IGMPRouterFilter packet rate, per packet (plain Click) against batched (FastClick)
+
+cd "$(dirname "$0")" || exit
+
+CLICK=${CLICK:-../../click/userlevel/click}
+FASTCLICK=${FASTCLICK:-../../fastclick/userlevel/click}
+
+for burst in 1 32 256; do
+	echo "per packet, burst $burst"
+	$CLICK router_filter.click BURST=$burst
+
+	if [ -x "$FASTCLICK" ]; then
+		echo "batched, burst $burst"
+		$FASTCLICK router_filter.click BURST=$burst
+	fi
+done
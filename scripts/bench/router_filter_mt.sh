@@ -0,0 +1,100 @@
+#!/bin/sh
+# IGMPRouterFilter packet rate over 1, 2, 4 and 8 threads, with the router changing the groups
+# while the filters forward.
+#
+# Every thread gets its own source and filter, all filters read the one IGMPRouterState. The router,
+# its clients and the state stay on thread 0 together with the first filter, client2 keeps joining
+# and leaving a group so the router publishes a new forwarding view every 10ms.
+#
+# usage: sh router_filter_mt.sh [seconds per run]
+
+cd "$(dirname "$0")" || exit
+
+CLICK=${CLICK:-../../click/userlevel/click}
+SECONDS_PER_RUN=${1:-2}
+
+config() {
+	threads=$1
+
+	cat <<EOF
+state :: IGMPRouterState;
+router :: IGMPRouter(state, LOGLEVEL none);
+
+router[0] -> Discard;
+router[1] -> Discard;
+router[2] -> Discard;
+
+Idle -> [0]router;
+
+cstate1 :: IGMPClientState;
+cstate2 :: IGMPClientState;
+
+Idle -> client1 :: IGMPClient(cstate1, LOGLEVEL none)
+	-> IGMPEncap(192.168.2.1)
+	-> [1]router;
+
+Idle -> client2 :: IGMPClient(cstate2, LOGLEVEL none)
+	-> IGMPEncap(192.168.3.1)
+	-> [2]router;
+
+churn :: Script(TYPE PASSIVE,
+	label again,
+	write client2.join 225.9.0.1,
+	wait 10ms,
+	write client2.leave 225.9.0.1,
+	wait 10ms,
+	goto again);
+EOF
+
+	i=0
+	while [ $i -lt "$threads" ]; do
+		cat <<EOF
+
+src$i :: InfiniteSource(LENGTH 64, LIMIT -1, BURST 32, ACTIVE false)
+	-> RoundRobinUDPIPEncap(10.0.$i.1 1234 225.1.0.1 1234,
+	                        10.0.$i.1 1234 225.1.0.2 1234,
+	                        10.0.$i.1 1234 226.1.0.1 1234,
+	                        10.0.$i.1 1234 225.1.0.5 1234)
+	-> filter$i :: IGMPRouterFilter(state);
+
+filter$i[0] -> Discard;
+filter$i[1] -> Discard;
+filter$i[2] -> Discard;
+EOF
+		i=$((i + 1))
+	done
+
+	# the sources on their own thread each, the control plane stays on thread 0
+	sched="src0 0"
+	start="write src0.active true,"
+	counts="\$(filter0.packets_in)"
+	i=1
+	while [ $i -lt "$threads" ]; do
+		sched="$sched, src$i $i"
+		start="$start write src$i.active true,"
+		counts="$counts \$(filter$i.packets_in)"
+		i=$((i + 1))
+	done
+	echo
+	echo "StaticThreadSched($sched);"
+
+	cat <<EOF
+
+DriverManager(
+	write client1.set 225.1.0.0/29,
+	write client2.set 225.1.0.0/29,
+	wait 500ms,
+	write churn.run,
+	set start \$(now),
+	$start
+	wait ${SECONDS_PER_RUN}s,
+	set elapsed \$(sub \$(now) \$start),
+	set packets \$(add $counts),
+	print "$threads threads: \$(div \$packets \$(mul \$elapsed 1000000)) Mpps, \$(state.publishes) publishes",
+	stop);
+EOF
+}
+
+for threads in 1 2 4 8; do
+	config $threads | $CLICK -j $threads
+done